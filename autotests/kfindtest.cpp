@@ -10,9 +10,11 @@
 
 #include <kfind.h>
 
+#include <QBuffer>
 #include <QRegularExpression>
 #include <QTest>
 
+#include <algorithm>
 #include <assert.h>
 
 void KFindRecorder::changeText(int line, const QString &text)
@@ -124,6 +126,60 @@ TestKFind::TestKFind()
         + QLatin1String("    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,\n") + QLatin1String("    Boston, MA 02110-1301, USA.\n");
 }
 
+void TestKFind::testStaticFindString_data()
+{
+    // Tests for the core method "static KFind::find" without KFind::RegularExpression
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("startIndex");
+    QTest::addColumn<int>("options");
+    QTest::addColumn<int>("expectedResult");
+    QTest::addColumn<int>("expectedMatchedLength");
+
+    const QString longText = QStringLiteral("the quick brown fox jumps over the lazy dog, the quick brown fox jumps over the lazy dog");
+
+    /* clang-format off */
+    QTest::newRow("simple") << "abc" << "b" << 0 << int(KFind::CaseSensitive) << 1 << 1;
+    QTest::newRow("not found") << "abca" << "ba" << 0 << int(KFind::CaseSensitive) << -1 << 0;
+    QTest::newRow("from index") << "abc bc" << "bc" << 2 << int(KFind::CaseSensitive) << 4 << 2;
+    QTest::newRow("dot is literal") << "abc b." << "b." << 0 << int(KFind::CaseSensitive) << 4 << 2;
+    QTest::newRow("long text") << longText << "lazy dog" << 0 << int(KFind::CaseSensitive) << 35 << 8;
+    QTest::newRow("long text, from index") << longText << "lazy dog" << 36 << int(KFind::CaseSensitive) << 80 << 8;
+    QTest::newRow("long pattern") << longText << "brown fox jumps over" << 11 << int(KFind::CaseSensitive) << 55 << 20;
+    QTest::newRow("long pattern backwards") << longText << "brown fox jumps over" << 54 << int(KFind::CaseSensitive | KFind::FindBackwards) << 10 << 20;
+    QTest::newRow("backwards") << longText << "the" << 87 << int(KFind::CaseSensitive | KFind::FindBackwards) << 76 << 3;
+    QTest::newRow("backwards, from index") << longText << "the" << 75 << int(KFind::CaseSensitive | KFind::FindBackwards) << 45 << 3;
+    QTest::newRow("case insensitive") << longText << "LAZY" << 0 << 0 << 35 << 4;
+    QTest::newRow("case insensitive, long pattern") << longText << "THE LAZY DOG, THE QUICK" << 0 << 0 << 31 << 23;
+    QTest::newRow("case insensitive, backwards") << longText << "The" << 87 << int(KFind::FindBackwards) << 76 << 3;
+    QTest::newRow("case insensitive, non-ASCII") << "un été chaud" << "ÉTÉ" << 0 << 0 << 3 << 3;
+    QTest::newRow("case insensitive, folds to ASCII") << QStringLiteral("273 \u212A") << "k" << 0 << 0 << 4 << 1;
+    QTest::newRow("case sensitive, non-ASCII") << "un été chaud" << "ÉTÉ" << 0 << int(KFind::CaseSensitive) << -1 << 0;
+    QTest::newRow("whole words") << "thesis the" << "the" << 0 << int(KFind::WholeWordsOnly) << 7 << 3;
+    QTest::newRow("whole words, inside identifiers") << "the_theme thesis the_ the" << "the" << 0 << int(KFind::WholeWordsOnly) << 22 << 3;
+    QTest::newRow("whole words, backwards") << "the_theme thesis the_ the" << "the" << 24 << int(KFind::WholeWordsOnly | KFind::FindBackwards) << 22 << 3;
+    QTest::newRow("whole words, backwards, not found") << "the_theme thesis the_ the" << "the" << 21 << int(KFind::WholeWordsOnly | KFind::FindBackwards) << -1 << 0;
+    QTest::newRow("whole words, pattern with space") << "a bc b c" << "b c" << 0 << int(KFind::WholeWordsOnly | KFind::CaseSensitive) << 5 << 3;
+    QTest::newRow("empty") << "a" << "" << 1 << int(0) << 1 << 0;
+    QTest::newRow("text shorter than pattern") << "a" << "abcd" << 0 << int(0) << -1 << 0;
+    /* clang-format on */
+}
+
+void TestKFind::testStaticFindString()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, pattern);
+    QFETCH(int, startIndex);
+    QFETCH(int, options);
+    QFETCH(int, expectedResult);
+    QFETCH(int, expectedMatchedLength);
+
+    int matchedLength = 0;
+    const int result = KFind::find(text, pattern, startIndex, options, &matchedLength, nullptr);
+    QCOMPARE(result, expectedResult);
+    QCOMPARE(matchedLength, expectedMatchedLength);
+}
+
 void TestKFind::testStaticFindRegexp_data()
 {
     // Tests for the core method "static KFind::find"
@@ -158,6 +214,12 @@ void TestKFind::testStaticFindRegexp_data()
     QTest::newRow("whole words not found (_)") << "abab ab_" << "ab" << 0 << int(KFind::WholeWordsOnly) << -1 << 0;
     QTest::newRow("whole words ok (.)") << "ab." << "ab" << 0 << int(KFind::WholeWordsOnly) << 0 << 2;
     QTest::newRow("backwards") << "abc bcbc bc" << "b." << 10 << int(KFind::FindBackwards) << 9 << 2;
+    QTest::newRow("backwards, overlapping") << "aaa" << "aa" << 2 << int(KFind::FindBackwards) << 0 << 2;
+    QTest::newRow("backwards, overlapping (2)") << "aaaa" << "aa" << 3 << int(KFind::FindBackwards) << 2 << 2;
+    QTest::newRow("\\K") << "xab" << "a\\Kb" << 0 << 0 << 2 << 1;
+    QTest::newRow("\\K backwards") << "xab" << "a\\Kb" << 3 << int(KFind::FindBackwards) << 2 << 1;
+    QTest::newRow("backwards, far from index") << QString(QStringLiteral("ab") + QString(10000, QLatin1Char(' '))) << "a." << 10001 << int(KFind::FindBackwards) << 0 << 2;
+    QTest::newRow("backwards, long match") << QString(QLatin1Char('a') + QString(20000, QLatin1Char('b'))) << "ab+" << 20000 << int(KFind::FindBackwards) << 0 << 20001;
     QTest::newRow("empty (0)") << "a" << "" << 0 << int(0) << 0 << 0;
     QTest::newRow("empty (1)") << "a" << "" << 1 << int(0) << 1 << 0; // kreplacetest testReplaceBlankSearch relies on this
     QTest::newRow("at end, not found") << "a" << "b" << 1 << int(0) << -1 << 0; // just for catching the while(index<text.length()) bug
@@ -165,6 +227,22 @@ void TestKFind::testStaticFindRegexp_data()
     QTest::newRow("back, at begin, found") << "a" << "a" << 0 << int(KFind::FindBackwards) << 0 << 1;
     QTest::newRow("back, at end, found") << "a" << "a" << 1 << int(KFind::FindBackwards) << 0 << 1;
     QTest::newRow("back, text shorter than pattern") << "a" << "abcd" << 0 << int(KFind::FindBackwards) << -1 << 0;
+    // patterns whose matches start with, or contain, a literal
+    QTest::newRow("literal prefix") << "WARN 1 ERROR x ERROR 42" << "ERROR\\s+\\d+" << 0 << 0 << 15 << 8;
+    QTest::newRow("literal prefix, case insensitive") << "error 7" << "ERROR\\s+\\d+" << 0 << 0 << 0 << 7;
+    QTest::newRow("literal prefix, backwards") << "ERROR 1 ERROR x" << "ERROR\\s+\\d+" << 14 << int(KFind::FindBackwards) << 0 << 7;
+    QTest::newRow("literal prefix, group") << "foobaz foobar" << "foo(bar|baz)" << 1 << 0 << 7 << 6;
+    QTest::newRow("literal prefix, optional character") << "color colour" << "colou?r" << 1 << 0 << 6 << 6;
+    QTest::newRow("literal prefix, escaped") << "1+2 1+1=2" << "1\\+1" << 0 << 0 << 4 << 3;
+    QTest::newRow("literal prefix, lookahead") << "abd abc" << "ab(?=c)" << 0 << 0 << 4 << 2;
+    QTest::newRow("literal prefix, whole words") << "foobar foo" << "foo" << 0 << int(KFind::WholeWordsOnly) << 7 << 3;
+    QTest::newRow("required literal") << "12 WARN 34 ERROR" << "\\d+ ERROR" << 0 << 0 << 8 << 8;
+    QTest::newRow("required literal, not found") << "12 WARN 34" << "\\d+ ERROR" << 0 << 0 << -1 << 0;
+    QTest::newRow("alternatives") << "bar foo" << "foo|bar" << 0 << 0 << 0 << 3;
+    QTest::newRow("literal prefix, \\K") << "foobar foobar" << "foo\\Kbar" << 4 << 0 << 10 << 3;
+    QTest::newRow("literal prefix, \\K backwards") << "foobar" << "foo\\Kbar" << 3 << int(KFind::FindBackwards) << 3 << 3;
+    QTest::newRow("literal prefix, \\K backwards, before the match") << "foobar" << "foo\\Kbar" << 1 << int(KFind::FindBackwards) << -1 << 0;
+    QTest::newRow("inline options") << "ABC abc" << "(?-i)abc" << 0 << 0 << 4 << 3;
     /* clang-format on */
 }
 
@@ -242,6 +320,270 @@ void TestKFind::testSimpleRegexp()
     QCOMPARE(test.hits().join(QString()), output);
 }
 
+void TestKFind::testRegexpPatternChange()
+{
+    // The compiled pattern must follow setPattern() and setOptions()
+    KFind find(QStringLiteral("w.r+anty"), KFind::RegularExpression, nullptr);
+    find.closeFindNextDialog();
+    find.setData(QStringLiteral("but WITHOUT ANY WARRANTY; without even the implied warranty"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.index(), 16);
+
+    find.setOptions(find.options() | KFind::CaseSensitive);
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.index(), 51);
+
+    find.setPattern(QStringLiteral("with[a-z]+"));
+    find.setData(QStringLiteral("but WITHOUT ANY WARRANTY; without even the implied warranty"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.index(), 26);
+}
+
+void TestKFind::testBackwardRegexp()
+{
+    // Stepping backwards finds the matches a forward search finds, in reverse
+    KFind find(QStringLiteral("aa"), KFind::RegularExpression | KFind::FindBackwards, nullptr);
+    find.closeFindNextDialog();
+    find.setData(QStringLiteral("aaaaa"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.index(), 2);
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.index(), 0);
+    QCOMPARE(find.find(), KFind::NoMatch);
+}
+
+static QString occurrencesToString(const QList<KFind::Occurrence> &occurrences)
+{
+    QStringList list;
+    for (const KFind::Occurrence &occurrence : occurrences) {
+        list.append(QStringLiteral("%1:%2+%3").arg(occurrence.dataId).arg(occurrence.index).arg(occurrence.length));
+    }
+    return list.join(QLatin1Char(' '));
+}
+
+void TestKFind::testStaticFindAll()
+{
+    const QString text = QStringLiteral("the theme of the thesis");
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("the"), 0)), QStringLiteral("-1:0+3 -1:4+3 -1:13+3 -1:17+3"));
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("the"), KFind::FindBackwards)), QStringLiteral("-1:0+3 -1:4+3 -1:13+3 -1:17+3"));
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("the"), KFind::WholeWordsOnly)), QStringLiteral("-1:0+3 -1:13+3"));
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("t[a-z]+e"), KFind::RegularExpression)), QStringLiteral("-1:0+3 -1:4+5 -1:13+3 -1:17+3"));
+    QVERIFY(KFind::findAll(text, QStringLiteral("THE"), KFind::CaseSensitive).isEmpty());
+}
+
+void TestKFind::testFindAll()
+{
+    KFind find(QStringLiteral("a"), KFind::FindIncremental, nullptr);
+    find.setData(0, QStringLiteral("a b a"));
+    find.setData(1, QStringLiteral("b A"));
+    QCOMPARE(occurrencesToString(find.findAll()), QStringLiteral("0:0+1 0:4+1 1:2+1"));
+    // findAll() doesn't count as finding
+    QCOMPARE(find.numMatches(), 0);
+
+    find.setOptions(KFind::CaseSensitive);
+    find.setData(QStringLiteral("a b A"));
+    QCOMPARE(occurrencesToString(find.findAll()), QStringLiteral("-1:0+1"));
+}
+
+static QString patternOccurrencesToString(const QList<KFind::Occurrence> &occurrences)
+{
+    QStringList list;
+    for (const KFind::Occurrence &occurrence : occurrences) {
+        list.append(QStringLiteral("%1+%2#%3").arg(occurrence.index).arg(occurrence.length).arg(occurrence.patternIndex));
+    }
+    return list.join(QLatin1Char(' '));
+}
+
+void TestKFind::testStaticFindAllPatterns()
+{
+    const QString text = QStringLiteral("he said she sold his shells");
+    const QStringList patterns = {QStringLiteral("he"), QStringLiteral("she"), QStringLiteral("his"), QStringLiteral("hers")};
+    QCOMPARE(patternOccurrencesToString(KFind::findAll(text, patterns, 0)), QStringLiteral("0+2#0 8+3#1 9+2#0 17+3#2 21+3#1 22+2#0"));
+    QCOMPARE(patternOccurrencesToString(KFind::findAll(text, patterns, KFind::WholeWordsOnly)), QStringLiteral("0+2#0 8+3#1 17+3#2"));
+    // the longest pattern wins at the same index
+    const QStringList mixedCase = {QStringLiteral("SHE"), QStringLiteral("sh")};
+    QCOMPARE(patternOccurrencesToString(KFind::findAll(text, mixedCase, 0)), QStringLiteral("8+3#0 21+3#0"));
+    QCOMPARE(patternOccurrencesToString(KFind::findAll(text, mixedCase, KFind::CaseSensitive)), QStringLiteral("8+2#1 21+2#1"));
+    // the patterns are never regular expressions
+    QVERIFY(KFind::findAll(text, {QStringLiteral("s.e")}, KFind::RegularExpression).isEmpty());
+}
+
+void TestKFind::testFindPatterns()
+{
+    KFind find(QStringLiteral("s"), 0, nullptr);
+    find.closeFindNextDialog();
+    find.setPatterns({QStringLiteral("he"), QStringLiteral("she"), QStringLiteral("his"), QStringLiteral("hers")});
+    QCOMPARE(find.pattern(), QStringLiteral("s"));
+
+    QStringList hits;
+    connect(&find, &KFind::textFound, this, [&hits, &find](const QString &, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1+%2#%3").arg(matchingIndex).arg(matchedLength).arg(find.matchedPatternIndex()));
+    });
+
+    const QString text = QStringLiteral("he said she sold his shells");
+    find.setData(text);
+    while (find.find() == KFind::Match) { }
+    QCOMPARE(hits.join(QLatin1Char(' ')), QStringLiteral("0+2#0 8+3#1 9+2#0 17+3#2 21+3#1 22+2#0"));
+    QCOMPARE(find.matchedPatternIndex(), -1);
+
+    hits.clear();
+    find.setOptions(KFind::FindBackwards);
+    find.setData(text);
+    while (find.find() == KFind::Match) { }
+    QCOMPARE(hits.join(QLatin1Char(' ')), QStringLiteral("22+2#0 21+3#1 17+3#2 9+2#0 8+3#1 0+2#0"));
+
+    // back to a single pattern
+    hits.clear();
+    find.setOptions(0);
+    find.setPatterns({});
+    find.setData(QStringLiteral("his"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(hits, QStringList{QStringLiteral("2+1#-1")});
+
+    hits.clear();
+    find.setPatterns({QStringLiteral("hi")});
+    find.setPattern(QStringLiteral("i"));
+    QVERIFY(find.patterns().isEmpty());
+    find.setData(QStringLiteral("his"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(hits, QStringList{QStringLiteral("1+1#-1")});
+}
+
+void TestKFind::testStaticFindApproximate()
+{
+    const QString text = QStringLiteral("Mr Jonathan Smyth and Mrs Smith wrote to Smithers");
+    const QString pattern = QStringLiteral("smith");
+    QCOMPARE(occurrencesToString(KFind::findAll(text, pattern, KFind::ApproximateMatch)), QStringLiteral("-1:12+5 -1:26+5 -1:41+5"));
+    QCOMPARE(occurrencesToString(KFind::findAll(text, pattern, KFind::ApproximateMatch | KFind::WholeWordsOnly)), QStringLiteral("-1:12+5 -1:26+5"));
+    // "Smith" is one edit away, "Smyth" two
+    QCOMPARE(occurrencesToString(KFind::findAll(text, pattern, KFind::ApproximateMatch | KFind::CaseSensitive)), QStringLiteral("-1:26+5 -1:41+5"));
+
+    int matchedLength = 0;
+    QCOMPARE(KFind::find(text, pattern, text.length(), KFind::ApproximateMatch | KFind::FindBackwards, &matchedLength, nullptr), 41);
+    QCOMPARE(matchedLength, 5);
+    // a match must end before the index when searching backwards
+    QCOMPARE(KFind::find(text, pattern, 40, KFind::ApproximateMatch | KFind::FindBackwards, &matchedLength, nullptr), 26);
+
+    // patterns longer than 64 characters
+    const QString longPattern = QStringLiteral("abcdefghij").repeated(8);
+    QString longText = longPattern;
+    longText[70] = QLatin1Char('!');
+    longText = QLatin1String("zz") + longText + QLatin1String("zz");
+    QCOMPARE(occurrencesToString(KFind::findAll(longText, longPattern, KFind::ApproximateMatch)), QStringLiteral("-1:2+80"));
+    QVERIFY(KFind::findAll(longText, longPattern, 0).isEmpty());
+}
+
+void TestKFind::testFindApproximate()
+{
+    KFind find(QStringLiteral("receive"), KFind::ApproximateMatch, nullptr);
+    find.closeFindNextDialog();
+
+    QStringList hits;
+    connect(&find, &KFind::textFound, this, [&hits](const QString &, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1+%2").arg(matchingIndex).arg(matchedLength));
+    });
+
+    const QString text = QStringLiteral("I receive, you recieved, they reseive");
+    find.setData(text);
+    while (find.find() == KFind::Match) { }
+    QCOMPARE(hits.join(QLatin1Char(' ')), QStringLiteral("2+7 30+7"));
+
+    // swapping two letters takes two edits
+    hits.clear();
+    find.setMaxEditDistance(2);
+    find.setData(text);
+    while (find.find() == KFind::Match) { }
+    QCOMPARE(hits.join(QLatin1Char(' ')), QStringLiteral("2+7 15+7 30+7"));
+
+    hits.clear();
+    find.setOptions(KFind::ApproximateMatch | KFind::FindBackwards);
+    find.setData(text);
+    while (find.find() == KFind::Match) { }
+    QCOMPARE(hits.join(QLatin1Char(' ')), QStringLiteral("30+7 15+7 2+7"));
+}
+
+void TestKFind::testStaticFindIgnoreDiacritics()
+{
+    // precomposed, decomposed, and without diacritics
+    const QString text = QStringLiteral("R\u00e9sum\u00e9, re\u0301sume\u0301 and resume");
+    const long options = KFind::IgnoreDiacritics;
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("resume"), options)), QStringLiteral("-1:0+6 -1:8+8 -1:21+6"));
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("r\u00e9sum\u00e9"), options)), QStringLiteral("-1:0+6 -1:8+8 -1:21+6"));
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("r.sum."), options | KFind::RegularExpression)), QStringLiteral("-1:0+6 -1:8+8 -1:21+6"));
+    QCOMPARE(occurrencesToString(KFind::findAll(text, QStringLiteral("resume"), 0)), QStringLiteral("-1:21+6"));
+
+    int matchedLength = 0;
+    QCOMPARE(KFind::find(text, QStringLiteral("resume"), text.length(), options | KFind::FindBackwards, &matchedLength, nullptr), 21);
+    QCOMPARE(KFind::find(text, QStringLiteral("resume"), 20, options | KFind::FindBackwards, &matchedLength, nullptr), 8);
+    QCOMPARE(matchedLength, 8);
+    QCOMPARE(KFind::find(text, QStringLiteral("sum"), 1, options, &matchedLength, nullptr), 2);
+
+    // Hangul syllables decompose into letters, not into a letter and marks
+    const QString hangul = QStringLiteral("\uac01 \uac00");
+    QCOMPARE(occurrencesToString(KFind::findAll(hangul, QStringLiteral("\uac00"), options)), QStringLiteral("-1:2+1"));
+    QCOMPARE(KFind::find(hangul, QStringLiteral("\uac00"), 0, options, &matchedLength, nullptr), 2);
+    QCOMPARE(matchedLength, 1);
+}
+
+void TestKFind::testFindIgnoreDiacritics()
+{
+    KFind find(QStringLiteral("creme"), KFind::IgnoreDiacritics | KFind::FindIncremental, nullptr);
+    find.closeFindNextDialog();
+
+    QStringList hits;
+    connect(&find, &KFind::textFoundAtId, this, [&hits](int id, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1:%2+%3").arg(id).arg(matchingIndex).arg(matchedLength));
+    });
+
+    find.setData(0, QStringLiteral("Cr\u00e8me br\u00fbl\u00e9e"));
+    find.setData(1, QStringLiteral("no cream"));
+    find.setData(2, QStringLiteral("cre\u0300me"));
+    QCOMPARE(occurrencesToString(find.findAll()), QStringLiteral("0:0+5 2:0+6"));
+
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::NoMatch);
+    QCOMPARE(hits, (QStringList{QStringLiteral("0:0+5"), QStringLiteral("2:0+6")}));
+}
+
+void TestKFind::testStreamFindAll_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("options");
+
+    QTest::newRow("literal") << QStringLiteral("needle") << 0;
+    QTest::newRow("case insensitive") << QStringLiteral("NEEDLE") << 0;
+    QTest::newRow("whole words") << QStringLiteral("needle") << int(KFind::WholeWordsOnly);
+    QTest::newRow("regexp") << QStringLiteral("n[a-z]+e\\b") << int(KFind::RegularExpression);
+    QTest::newRow("regexp lookbehind") << QStringLiteral("(?<=\u00e9 )needle") << int(KFind::RegularExpression);
+}
+
+void TestKFind::testStreamFindAll()
+{
+    QFETCH(QString, pattern);
+    QFETCH(int, options);
+
+    // Big enough for several chunks, with matches and multi-byte characters
+    // across their boundaries
+    QString text;
+    for (int i = 0; text.size() < 3 * 1024 * 1024; ++i) {
+        text += (i % 3 ? QStringLiteral("\u00e9 needle ") : QStringLiteral("needles \U0001F600"));
+    }
+    QByteArray data = text.toUtf8();
+    QBuffer buffer(&data);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    bool ok = false;
+    const QList<KFind::StreamOccurrence> occurrences = KFind::findAll(&buffer, pattern, options, &ok);
+    QVERIFY(ok);
+    const QList<KFind::Occurrence> expected = KFind::findAll(text, pattern, options);
+    QCOMPARE(occurrences.size(), expected.size());
+    for (int i = 0; i < expected.size(); ++i) {
+        QCOMPARE(occurrences.at(i).index, expected.at(i).index);
+        QCOMPARE(occurrences.at(i).length, expected.at(i).length);
+    }
+}
+
 void TestKFind::testLineBeginRegularExpression()
 {
     int matchedLength;
@@ -334,6 +676,234 @@ void TestKFind::testFindIncrementalDynamic()
     QCOMPARE(test.hits().join(QString()), output3);
 }
 
+static QStringList findInBlocks(const QStringList &blocks, const QString &pattern, long options, bool parallel)
+{
+    KFind find(pattern, options | KFind::FindIncremental, nullptr);
+    find.closeFindNextDialog();
+    find.setParallelSearch(parallel);
+
+    QStringList hits;
+    QObject::connect(&find, &KFind::textFoundAtId, &find, [&hits](int id, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1:%2+%3").arg(id).arg(matchingIndex).arg(matchedLength));
+    });
+
+    for (int i = 0; i < blocks.count(); ++i) {
+        find.setData(i, blocks.at(i));
+    }
+    while (find.find() == KFind::Match) { }
+    return hits;
+}
+
+void TestKFind::testFindIncrementalParallel()
+{
+    // Searching the blocks in parallel must find the same matches, in the same order
+    QStringList blocks;
+    for (int i = 0; i < 200; ++i) {
+        blocks.append((i % 37 == 5) ? QStringLiteral("hay needle hay needle") : QStringLiteral("hay hay hay"));
+    }
+
+    const QStringList expected = {
+        QStringLiteral("5:4+6"),
+        QStringLiteral("5:15+6"),
+        QStringLiteral("42:4+6"),
+        QStringLiteral("42:15+6"),
+        QStringLiteral("79:4+6"),
+        QStringLiteral("79:15+6"),
+        QStringLiteral("116:4+6"),
+        QStringLiteral("116:15+6"),
+        QStringLiteral("153:4+6"),
+        QStringLiteral("153:15+6"),
+        QStringLiteral("190:4+6"),
+        QStringLiteral("190:15+6"),
+    };
+    QCOMPARE(findInBlocks(blocks, QStringLiteral("needle"), 0, false), expected);
+    QCOMPARE(findInBlocks(blocks, QStringLiteral("needle"), 0, true), expected);
+    QCOMPARE(findInBlocks(blocks, QStringLiteral("need"), KFind::WholeWordsOnly, true), QStringList());
+}
+
+void TestKFind::testFindIncrementalNarrowing()
+{
+    KFind find(QStringLiteral("h"), KFind::FindIncremental, nullptr);
+    find.closeFindNextDialog();
+
+    QStringList hits;
+    connect(&find, &KFind::textFoundAtId, this, [&hits](int id, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1:%2+%3").arg(id).arg(matchingIndex).arg(matchedLength));
+    });
+
+    find.setData(0, QStringLiteral("say hello"));
+    find.setData(1, QStringLiteral("Help her"));
+    find.setData(2, QStringLiteral("oh"));
+
+    QCOMPARE(find.find(), KFind::Match);
+    find.setPattern(QStringLiteral("he"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::Match);
+
+    // a block that changes after the occurrences were collected is searched again
+    find.setData(2, QStringLiteral("ohhe"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::NoMatch);
+
+    const QStringList expected = {
+        QStringLiteral("0:4+1"),
+        QStringLiteral("0:4+2"),
+        QStringLiteral("1:0+2"),
+        QStringLiteral("1:5+2"),
+        QStringLiteral("2:2+2"),
+    };
+    QCOMPARE(hits, expected);
+}
+
+void TestKFind::testFindIncrementalManyOccurrences()
+{
+    // more occurrences of "a" than an incremental search keeps
+    const int count = (1 << 20) + 1;
+    KFind find(QStringLiteral("a"), KFind::FindIncremental, nullptr);
+    find.closeFindNextDialog();
+
+    QStringList hits;
+    connect(&find, &KFind::textFoundAtId, this, [&hits](int id, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1:%2+%3").arg(id).arg(matchingIndex).arg(matchedLength));
+    });
+
+    find.setData(0, QString(count, QLatin1Char('a')) + QLatin1Char('b'));
+    find.setData(1, QStringLiteral("ab"));
+
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::Match);
+    find.setPattern(QStringLiteral("ab"));
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::Match);
+    QCOMPARE(find.find(), KFind::NoMatch);
+
+    const QStringList expected = {
+        QStringLiteral("0:0+1"),
+        QStringLiteral("0:1+1"),
+        QStringLiteral("0:%1+2").arg(count - 1),
+        QStringLiteral("1:0+2"),
+    };
+    QCOMPARE(hits, expected);
+}
+
+void TestKFind::testFindDeadline_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("options");
+
+    QTest::newRow("literal") << QStringLiteral("needle") << 0;
+    QTest::newRow("literal backwards") << QStringLiteral("needle") << int(KFind::FindBackwards);
+    QTest::newRow("whole words") << QStringLiteral("needle") << int(KFind::WholeWordsOnly);
+    QTest::newRow("regexp") << QStringLiteral("ne+dle") << int(KFind::RegularExpression);
+    QTest::newRow("regexp backwards") << QStringLiteral("ne+dle") << int(KFind::RegularExpression | KFind::FindBackwards);
+    QTest::newRow("ignoring diacritics") << QStringLiteral("n\u00e9edle") << int(KFind::IgnoreDiacritics);
+    QTest::newRow("ignoring diacritics backwards") << QStringLiteral("n\u00e9edle") << int(KFind::IgnoreDiacritics | KFind::FindBackwards);
+    QTest::newRow("regexp ignoring diacritics") << QStringLiteral("n\u00e9+dle") << int(KFind::RegularExpression | KFind::IgnoreDiacritics);
+}
+
+void TestKFind::testFindDeadline()
+{
+    QFETCH(QString, pattern);
+    QFETCH(int, options);
+
+    const QString filler(200000, QLatin1Char('x'));
+    const QString text = QLatin1String("a needle ") + filler + QLatin1String(" needle ") + filler + QLatin1String(" needle");
+
+    KFind find(pattern, options, nullptr);
+    find.closeFindNextDialog();
+
+    QStringList hits;
+    connect(&find, &KFind::textFound, this, [&hits](const QString &, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1+%2").arg(matchingIndex).arg(matchedLength));
+    });
+
+    find.setData(text);
+    // an expired deadline still lets each call search a slice of the text
+    int interruptions = 0;
+    KFind::Result result;
+    while ((result = find.find(QDeadlineTimer(0))) != KFind::NoMatch) {
+        if (result == KFind::Interrupted) {
+            ++interruptions;
+        }
+    }
+    QVERIFY(interruptions > 0);
+
+    QStringList expected = {QStringLiteral("2+6"), QStringLiteral("200010+6"), QStringLiteral("400018+6")};
+    if (options & KFind::FindBackwards) {
+        std::reverse(expected.begin(), expected.end());
+    }
+    QCOMPARE(hits, expected);
+}
+
+void TestKFind::testFindIncrementalDeadline()
+{
+    // Looking for the occurrences of an incremental search stops at the deadline too
+    KFind find(QStringLiteral("needle"), KFind::FindIncremental, nullptr);
+    find.closeFindNextDialog();
+
+    QStringList hits;
+    connect(&find, &KFind::textFoundAtId, this, [&hits](int id, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1:%2+%3").arg(id).arg(matchingIndex).arg(matchedLength));
+    });
+
+    for (int id = 0; id < 100; ++id) {
+        find.setData(id, id == 99 ? QStringLiteral("a needle") : QStringLiteral("hay"));
+    }
+
+    int interruptions = 0;
+    KFind::Result result;
+    while ((result = find.find(QDeadlineTimer(0))) == KFind::Interrupted) {
+        ++interruptions;
+    }
+    QCOMPARE(result, KFind::Match);
+    QVERIFY(interruptions > 0);
+    QCOMPARE(hits, QStringList{QStringLiteral("99:2+6")});
+}
+
+void TestKFind::testFindAsync()
+{
+    KFind find(QStringLiteral("needle"), KFind::FindIncremental, nullptr);
+    find.closeFindNextDialog();
+
+    QStringList hits;
+    connect(&find, &KFind::textFoundAtId, this, [&hits](int id, int matchingIndex, int matchedLength) {
+        hits.append(QStringLiteral("%1:%2+%3").arg(id).arg(matchingIndex).arg(matchedLength));
+    });
+
+    find.setData(0, QStringLiteral("a needle"));
+    find.setData(1, QStringLiteral("no"));
+    find.setData(2, QStringLiteral("needle and needle"));
+
+    QFuture<QList<KFind::Occurrence>> all = find.findAllAsync();
+    all.waitForFinished();
+    QCOMPARE(occurrencesToString(all.result()), QStringLiteral("0:2+6 2:0+6 2:11+6"));
+    QCOMPARE(all.progressValue(), 3);
+
+    // the search moves on once the result is back in this thread
+    QFuture<KFind::Result> next = find.findNextAsync();
+    QTRY_VERIFY(next.isFinished());
+    QCOMPARE(next.result(), KFind::Match);
+    QCOMPARE(hits, QStringList{QStringLiteral("0:2+6")});
+
+    // but not if the search was changed meanwhile
+    next = find.findNextAsync();
+    find.setOptions(find.options());
+    QTRY_VERIFY(next.isFinished());
+    QCOMPARE(next.result(), KFind::Match);
+    QCOMPARE(hits.count(), 1);
+
+    for (int i = 0; i < 2; ++i) {
+        next = find.findNextAsync();
+        QTRY_VERIFY(next.isFinished());
+        QCOMPARE(next.result(), KFind::Match);
+    }
+    next = find.findNextAsync();
+    QTRY_VERIFY(next.isFinished());
+    QCOMPARE(next.result(), KFind::NoMatch);
+    QCOMPARE(hits.join(QLatin1Char(' ')), QStringLiteral("0:2+6 2:0+6 2:11+6"));
+}
+
 QTEST_MAIN(TestKFind)
 
 #include "moc_kfindtest.cpp"
@@ -56,6 +56,9 @@ public:
 
 private Q_SLOTS:
 
+    void testStaticFindString_data();
+    void testStaticFindString();
+
     void testStaticFindRegexp_data();
     void testStaticFindRegexp();
 
@@ -64,10 +67,29 @@ private Q_SLOTS:
 
     void testSimpleSearch();
     void testSimpleRegexp();
+    void testRegexpPatternChange();
+    void testBackwardRegexp();
+    void testStaticFindAll();
+    void testFindAll();
+    void testStaticFindAllPatterns();
+    void testFindPatterns();
+    void testStaticFindApproximate();
+    void testFindApproximate();
+    void testStaticFindIgnoreDiacritics();
+    void testFindIgnoreDiacritics();
+    void testStreamFindAll_data();
+    void testStreamFindAll();
 
     void testLineBeginRegularExpression();
     void testFindIncremental();
     void testFindIncrementalDynamic();
+    void testFindIncrementalParallel();
+    void testFindIncrementalNarrowing();
+    void testFindIncrementalManyOccurrences();
+    void testFindDeadline_data();
+    void testFindDeadline();
+    void testFindIncrementalDeadline();
+    void testFindAsync();
 
 private:
     QString m_text;
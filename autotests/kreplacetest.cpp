@@ -11,9 +11,11 @@
 #include <stdlib.h>
 
 #include <QApplication>
+#include <QBuffer>
 #include <QDebug>
 #include <QEventLoop>
 #include <QPushButton>
+#include <QRegularExpression>
 
 #include <kreplace.h>
 #include <kreplacedialog.h>
@@ -72,6 +74,11 @@ void KReplaceTest::replace(const QString &pattern, const QString &replacement, l
     }
 }
 
+int KReplaceTest::numReplacements() const
+{
+    return m_replace ? m_replace->numReplacements() : 0;
+}
+
 void KReplaceTest::slotHighlight(const QString &str, int matchingIndex, int matchedLength)
 {
     qDebug() << "slotHighlight Index:" << matchingIndex << " Length:" << matchedLength << " Substr:" << str.mid(matchingIndex, matchedLength);
@@ -291,6 +298,216 @@ static void testReplacementHistory()
     testReplacementHistory(findHistory, replaceHistory);
 }
 
+// Test for backrefs with more than one digit
+static void testReplaceBackRef10(int options, const QString &buttonName = QString())
+{
+    KReplaceTest test(QStringList() << QStringLiteral("abcdefghij ab"), buttonName);
+    test.replace(QStringLiteral("(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)"), QStringLiteral("\\10\\1\\100"), options);
+    test.replace(QStringLiteral("(a)(b)"), QStringLiteral("\\10\\2"), options);
+    QStringList textLines = test.textLines();
+    assert(textLines.count() == 1);
+    QString expected = QStringLiteral("jaj0 a0b");
+    if (textLines[0] != expected) {
+        qCritical() << "ASSERT FAILED: replaced text is '" << textLines[0] << "' instead of '" << expected << "'";
+        exit(1);
+    }
+}
+
+// Test for named backrefs and case conversion
+static void testReplaceNamedBackRef(int options, const QString &buttonName = QString())
+{
+    KReplaceTest test(QStringList() << QStringLiteral("int fooBar = get_value();"), buttonName);
+    test.replace(QStringLiteral("(?<type>\\w+) (?<first>\\w)(\\w*)"), QStringLiteral("\\U${first}\\E\\3: \\L\\g{type}X\\E\\g{none}"), options);
+    QStringList textLines = test.textLines();
+    assert(textLines.count() == 1);
+    QString expected = QStringLiteral("FooBar: intx\\g{none} = get_value();");
+    if (textLines[0] != expected) {
+        qCritical() << "ASSERT FAILED: replaced text is '" << textLines[0] << "' instead of '" << expected << "'";
+        exit(1);
+    }
+}
+
+// Without a regular expression, only \0 is a placeholder
+static void testReplaceLiteralBackRef(int options, const QString &buttonName = QString())
+{
+    KReplaceTest test(QStringList() << QStringLiteral("foo bar"), buttonName);
+    test.replace(QStringLiteral("foo"), QStringLiteral("\\U\\0${0}\\g{0}\\E"), options);
+    QStringList textLines = test.textLines();
+    assert(textLines.count() == 1);
+    QString expected = QStringLiteral("\\Ufoo${0}\\g{0}\\E bar");
+    if (textLines[0] != expected) {
+        qCritical() << "ASSERT FAILED: replaced text is '" << textLines[0] << "' instead of '" << expected << "'";
+        exit(1);
+    }
+}
+
+// The captures of a match found regardless of diacritics keep them
+static void testReplaceIgnoreDiacritics(int options, const QString &buttonName = QString())
+{
+    KReplaceTest test(QStringList() << QStringLiteral("R\u00e9sum\u00e9, re\u0301sume\u0301 and resume"), buttonName);
+    test.replace(QStringLiteral("r(.)sum(.)"), QStringLiteral("[\\0|\\1\\2]"), options);
+    QStringList textLines = test.textLines();
+    assert(textLines.count() == 1);
+    QString expected = QStringLiteral("[R\u00e9sum\u00e9|\u00e9\u00e9], [re\u0301sume\u0301|e\u0301e\u0301] and [resume|ee]");
+    if (textLines[0] != expected) {
+        qCritical() << "ASSERT FAILED: replaced text is '" << textLines[0] << "' instead of '" << expected << "'";
+        exit(1);
+    }
+}
+
+// Computing the replacements on a worker thread
+static void testReplaceAllAsync()
+{
+    QString text = QStringLiteral("a1 b2 a3");
+    QFuture<QList<KReplace::Replacement>> future =
+        KReplace::replaceAllAsync(text, QStringLiteral("([ab])([\\d])"), QStringLiteral("\\2\\1"), 1, KReplaceDialog::BackReference | KFind::RegularExpression);
+    future.waitForFinished();
+    const QList<KReplace::Replacement> replacements = future.result();
+    if (replacements.count() != 2 || replacements.at(0).index != 3 || replacements.at(0).matchedLength != 2 || replacements.at(0).text != QLatin1String("2b")) {
+        qCritical() << "ASSERT FAILED: unexpected replacements" << replacements.count();
+        exit(1);
+    }
+    for (auto it = replacements.crbegin(); it != replacements.crend(); ++it) {
+        text.replace(it->index, it->matchedLength, it->text);
+    }
+    if (text != QLatin1String("a1 2b 3a")) {
+        qCritical() << "ASSERT FAILED: replaced text is '" << text << "' instead of 'a1 2b 3a'";
+        exit(1);
+    }
+}
+
+// Replacing from one device to another, in chunks
+static void testReplaceAllStream()
+{
+    QString text;
+    for (int i = 0; text.size() < 3 * 1024 * 1024; ++i) {
+        text += QStringLiteral("\u00e9t\u00e9 %1, ").arg(i);
+    }
+    QByteArray input = text.toUtf8();
+    QBuffer inputBuffer(&input);
+    inputBuffer.open(QIODevice::ReadOnly);
+    QByteArray output;
+    QBuffer outputBuffer(&output);
+    outputBuffer.open(QIODevice::WriteOnly);
+
+    const QString pattern = QStringLiteral("\u00e9t\u00e9 (\\d+)");
+    const QString replacement = QStringLiteral("summer \\1");
+    const long options = KFind::RegularExpression | KReplaceDialog::BackReference;
+    const qint64 replacements = KReplace::replaceAll(&inputBuffer, &outputBuffer, pattern, replacement, options);
+
+    const QRegularExpression re(pattern);
+    QString expected = text;
+    expected.replace(re, replacement);
+    int expectedReplacements = 0;
+    for (auto it = re.globalMatch(text); it.hasNext(); it.next()) {
+        ++expectedReplacements;
+    }
+    if (replacements != expectedReplacements || QString::fromUtf8(output) != expected) {
+        qCritical() << "ASSERT FAILED: streaming replacement made" << replacements << "replacements instead of" << expectedReplacements;
+        exit(1);
+    }
+}
+
+// Previewing the replacements, then doing them
+static void testPendingReplacements()
+{
+    KReplace replace(QStringLiteral("o"), QStringLiteral("0"), 0);
+    replace.setData(QStringLiteral("foo boo"), 2);
+    const QList<KReplace::Replacement> pending = replace.pendingReplacements();
+    if (pending.count() != 3 || pending.at(0).index != 2 || pending.at(2).index != 6 || pending.at(1).text != QLatin1String("0")) {
+        qCritical() << "ASSERT FAILED: unexpected pending replacements" << pending.count();
+        exit(1);
+    }
+    // the preview changes nothing
+    if (replace.pendingReplacements().count() != 3 || replace.numReplacements() != 0) {
+        qCritical() << "ASSERT FAILED: the preview replaced something";
+        exit(1);
+    }
+
+    QString text;
+    QObject::connect(&replace, &KReplace::textReplaced, [&text](const QString &replaced) {
+        text = replaced;
+    });
+    replace.replace();
+    if (text != QLatin1String("fo0 b00") || replace.numReplacements() != 3) {
+        qCritical() << "ASSERT FAILED: replaced text is '" << text << "' instead of 'fo0 b00'";
+        exit(1);
+    }
+}
+
+// Replacing all at once, with only replacementsDone() connected
+static void testReplacementsDone()
+{
+    KReplace replace(QStringLiteral("o"), QStringLiteral("00"), 0);
+    replace.setData(QStringLiteral("foo boo"));
+
+    QString text;
+    QList<KReplace::Replacement> replacements;
+    QObject::connect(&replace, &KReplace::replacementsDone, [&](const QString &replaced, const QList<KReplace::Replacement> &done) {
+        text = replaced;
+        replacements = done;
+    });
+    replace.replace();
+    if (text != QLatin1String("f0000 b0000") || replace.numReplacements() != 4) {
+        qCritical() << "ASSERT FAILED: replaced text is '" << text << "' instead of 'f0000 b0000'";
+        exit(1);
+    }
+    if (replacements.count() != 4 || replacements.at(1).index != 2 || replacements.at(3).index != 6) {
+        qCritical() << "ASSERT FAILED: unexpected replacements" << replacements.count();
+        exit(1);
+    }
+
+    // textReplaced() still gets the text as it is after each replacement
+    KReplace replaceEach(QStringLiteral("o"), QStringLiteral("00"), 0);
+    replaceEach.setData(QStringLiteral("foo boo"));
+    QStringList texts;
+    QObject::connect(&replaceEach, &KReplace::textReplaced, [&texts](const QString &replaced) {
+        texts.append(replaced);
+    });
+    replaceEach.replace();
+    const QStringList expected{QStringLiteral("f00o boo"), QStringLiteral("f0000 boo"), QStringLiteral("f0000 b00o"), QStringLiteral("f0000 b0000")};
+    if (texts != expected) {
+        qCritical() << "ASSERT FAILED: replaced texts are" << texts << "instead of" << expected;
+        exit(1);
+    }
+}
+
+// Replacing with a regular expression that looks around its matches: without
+// prompting, the matches are all found in the text before any replacement
+static void testReplaceContextDependent(int options, const QString &buttonName, const QString &expectedStart, const QString &expectedLookbehind)
+{
+    qDebug() << "testReplaceContextDependent: " << options;
+    KReplaceTest start(QStringList() << QStringLiteral("aaa"), buttonName);
+    start.replace(QStringLiteral("^a"), QString(), options | KFind::RegularExpression);
+    if (start.textLines() != QStringList{expectedStart}) {
+        qCritical() << "ASSERT FAILED: replaced text is" << start.textLines() << "instead of" << expectedStart;
+        exit(1);
+    }
+    KReplaceTest lookbehind(QStringList() << QStringLiteral("baaa"), buttonName);
+    lookbehind.replace(QStringLiteral("(?<=b)a"), QStringLiteral("b"), options | KFind::RegularExpression);
+    if (lookbehind.textLines() != QStringList{expectedLookbehind}) {
+        qCritical() << "ASSERT FAILED: replaced text is" << lookbehind.textLines() << "instead of" << expectedLookbehind;
+        exit(1);
+    }
+}
+
+// Replacing many occurrences spread over several lines
+static void testReplaceMany(int options, const QString &buttonName = QString())
+{
+    qDebug() << "testReplaceMany: " << options;
+    KReplaceTest test(QStringList() << QStringLiteral("a-a-a") << QString() << QStringLiteral("xa") << QStringLiteral("aa"), buttonName);
+    test.replace(QStringLiteral("a"), QStringLiteral("bcd"), options);
+    const QStringList expected{QStringLiteral("bcd-bcd-bcd"), QString(), QStringLiteral("xbcd"), QStringLiteral("bcdbcd")};
+    if (test.textLines() != expected) {
+        qCritical() << "ASSERT FAILED: replaced text is" << test.textLines() << "instead of" << expected;
+        exit(1);
+    }
+    if (test.numReplacements() != 6) {
+        qCritical() << "ASSERT FAILED: number of replacements is" << test.numReplacements() << "instead of 6";
+        exit(1);
+    }
+}
+
 int main(int argc, char **argv)
 {
     QApplication::setApplicationName(QStringLiteral("kreplacetest"));
@@ -355,6 +572,33 @@ int main(int argc, char **argv)
 
     testReplaceBackRef1(KReplaceDialog::BackReference | KFind::RegularExpression, QStringLiteral("replaceButton")); // replace
     testReplaceBackRef1(KReplaceDialog::BackReference | KFind::RegularExpression, QStringLiteral("allButton")); // replace all
+    testReplaceBackRef1(KReplaceDialog::BackReference | KFind::RegularExpression);
+
+    testReplaceBackRef10(KReplaceDialog::BackReference | KFind::RegularExpression);
+    testReplaceBackRef10(KReplaceDialog::BackReference | KFind::RegularExpression | KReplaceDialog::PromptOnReplace, QStringLiteral("replaceButton"));
+
+    testReplaceNamedBackRef(KReplaceDialog::BackReference | KFind::RegularExpression);
+    testReplaceNamedBackRef(KReplaceDialog::BackReference | KFind::RegularExpression | KReplaceDialog::PromptOnReplace, QStringLiteral("replaceButton"));
+    testReplaceLiteralBackRef(KReplaceDialog::BackReference);
+    testReplaceLiteralBackRef(KReplaceDialog::BackReference | KReplaceDialog::PromptOnReplace, QStringLiteral("replaceButton"));
+
+    const long diacriticsOptions = KReplaceDialog::BackReference | KFind::RegularExpression | KFind::IgnoreDiacritics;
+    testReplaceIgnoreDiacritics(diacriticsOptions);
+    testReplaceIgnoreDiacritics(diacriticsOptions | KReplaceDialog::PromptOnReplace, QStringLiteral("replaceButton")); // replace
+    testReplaceIgnoreDiacritics(diacriticsOptions | KFind::FindBackwards);
+
+    testReplaceAllAsync();
+    testPendingReplacements();
+    testReplacementsDone();
+    testReplaceAllStream();
+
+    testReplaceContextDependent(0, QString(), QStringLiteral("aa"), QStringLiteral("bbaa"));
+    testReplaceContextDependent(KReplaceDialog::PromptOnReplace, QStringLiteral("replaceButton"), QString(), QStringLiteral("bbbb")); // replace
+
+    testReplaceMany(0);
+    testReplaceMany(KReplaceDialog::PromptOnReplace, QStringLiteral("replaceButton")); // replace
+    testReplaceMany(KReplaceDialog::PromptOnReplace, QStringLiteral("allButton")); // replace all
+    testReplaceMany(KFind::FindBackwards);
 
     QString text = QLatin1String("This file is part of the KDE project.\n") + QLatin1String("This library is free software; you can redistribute it and/or\n")
         + QLatin1String("modify it under the terms of the GNU Library General Public\n")
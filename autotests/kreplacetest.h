@@ -26,6 +26,7 @@ public:
     {
         return m_text;
     }
+    int numReplacements() const;
 
 public Q_SLOTS:
     void slotHighlight(const QString &, int, int);
@@ -7,8 +7,13 @@
 */
 
 #include <QClipboard>
+#include <QComboBox>
+#include <QSignalSpy>
 #include <QTest>
+#include <QTimer>
 
+#include <kfinddialog.h>
+#include <kreplacedialog.h>
 #include <ktextedit.h>
 
 class KTextEdit_UnitTest : public QObject
@@ -17,6 +22,13 @@ class KTextEdit_UnitTest : public QObject
 
 private Q_SLOTS:
     void testPaste();
+    void testFindInBlocks();
+    void testFindMatchCount();
+    void testFindMatchCountAfterTable();
+    void testReplaceAll();
+    void testReplaceAllBackwards();
+    void testReplaceAllInBackground();
+    void testReplaceAllInBackgroundCanceled();
     // These tests are probably invalid due to using invalid html.
     //     void testImportWithHorizontalTraversal();
     //     void testImportWithVerticalTraversal();
@@ -36,6 +48,233 @@ void KTextEdit_UnitTest::testPaste()
     QApplication::clipboard()->setText(origText);
 }
 
+void KTextEdit_UnitTest::testFindInBlocks()
+{
+    KTextEdit w;
+    w.setPlainText(QStringLiteral("first line\nsecond needle\nthird\u00a0needle"));
+    QVERIFY(QMetaObject::invokeMethod(&w, "slotFind"));
+    KFindDialog *dialog = w.findChild<KFindDialog *>();
+    QVERIFY(dialog);
+    dialog->setPattern(QStringLiteral("needle"));
+    dialog->setOptions(0);
+    Q_EMIT dialog->okClicked();
+
+    // nothing was connected to findMatchCountChanged(), so nothing is counted
+    QSignalSpy spy(&w, &KTextEdit::findMatchCountChanged);
+    QVERIFY(!spy.wait(500));
+
+    // the matches are mapped back from their block to the document
+    QCOMPARE(w.textCursor().selectionStart(), 18);
+    QCOMPARE(w.textCursor().selectedText(), QStringLiteral("needle"));
+
+    QVERIFY(QMetaObject::invokeMethod(&w, "slotFindNext"));
+    QCOMPARE(w.textCursor().selectionStart(), 31);
+    QCOMPARE(w.textCursor().selectedText(), QStringLiteral("needle"));
+
+    QVERIFY(QMetaObject::invokeMethod(&w, "slotFindPrevious"));
+    QCOMPARE(w.textCursor().selectionStart(), 18);
+}
+
+void KTextEdit_UnitTest::testFindMatchCount()
+{
+    KTextEdit w;
+    w.setPlainText(QStringLiteral("needle\nhay needle hay\nneedle"));
+    QSignalSpy spy(&w, &KTextEdit::findMatchCountChanged);
+    QVERIFY(QMetaObject::invokeMethod(&w, "slotFind"));
+    KFindDialog *dialog = w.findChild<KFindDialog *>();
+    QVERIFY(dialog);
+    dialog->setPattern(QStringLiteral("needle"));
+    dialog->setOptions(0);
+    Q_EMIT dialog->okClicked();
+
+    // the matches are counted in the background
+    QTRY_VERIFY(spy.last().at(2).toBool());
+    QCOMPARE(spy.last().at(0).toInt(), 1);
+    QCOMPARE(spy.last().at(1).toInt(), 3);
+
+    QVERIFY(QMetaObject::invokeMethod(&w, "slotFindNext"));
+    QCOMPARE(spy.last().at(0).toInt(), 2);
+    QCOMPARE(spy.last().at(1).toInt(), 3);
+
+    // editing the document counts them again
+    QTextCursor tc = w.textCursor();
+    tc.movePosition(QTextCursor::End);
+    tc.insertText(QStringLiteral(" needle"));
+    QCOMPARE(spy.last().at(1).toInt(), 0);
+    QVERIFY(!spy.last().at(2).toBool());
+    QTRY_VERIFY(spy.last().at(2).toBool());
+    QCOMPARE(spy.last().at(0).toInt(), 0);
+    QCOMPARE(spy.last().at(1).toInt(), 4);
+
+    // once the search is over, editing the document doesn't count anything
+    w.clear();
+    QVERIFY(QMetaObject::invokeMethod(&w, "slotFindNext"));
+    spy.clear();
+    w.setPlainText(QStringLiteral("needle"));
+    QVERIFY(!spy.wait(1000));
+}
+
+void KTextEdit_UnitTest::testFindMatchCountAfterTable()
+{
+    // The blocks after a table don't start where the previous one ends
+    KTextEdit w;
+    w.setPlainText(QStringLiteral("needle"));
+    QTextCursor tc = w.textCursor();
+    tc.movePosition(QTextCursor::End);
+    tc.insertTable(1, 1);
+    tc.insertText(QStringLiteral("hay needle"));
+    tc.movePosition(QTextCursor::End);
+    tc.insertText(QStringLiteral("needle"));
+
+    QSignalSpy spy(&w, &KTextEdit::findMatchCountChanged);
+    QVERIFY(QMetaObject::invokeMethod(&w, "slotFind"));
+    KFindDialog *dialog = w.findChild<KFindDialog *>();
+    QVERIFY(dialog);
+
+    // searching each block, then the whole document
+    for (const long options : {0L, long(KFind::RegularExpression)}) {
+        dialog->setPattern(QStringLiteral("needle"));
+        dialog->setOptions(options);
+        spy.clear();
+        Q_EMIT dialog->okClicked();
+        QTRY_VERIFY(!spy.isEmpty() && spy.last().at(2).toBool());
+        QCOMPARE(spy.last().at(0).toInt(), 1);
+        QCOMPARE(spy.last().at(1).toInt(), 3);
+
+        QVERIFY(QMetaObject::invokeMethod(&w, "slotFindNext"));
+        QCOMPARE(spy.last().at(0).toInt(), 2);
+        QVERIFY(QMetaObject::invokeMethod(&w, "slotFindNext"));
+        QCOMPARE(w.textCursor().selectionStart(), w.document()->lastBlock().position());
+        QCOMPARE(spy.last().at(0).toInt(), 3);
+        QCOMPARE(spy.last().at(1).toInt(), 3);
+    }
+}
+
+// Closes the message boxes telling how many replacements were done, as they show up
+static void closeMessageBoxes(QObject *parent)
+{
+    auto *timer = new QTimer(parent);
+    QObject::connect(timer, &QTimer::timeout, timer, []() {
+        if (QWidget *dialog = QApplication::activeModalWidget()) {
+            dialog->close();
+        }
+    });
+    timer->start(10);
+}
+
+// Starts replacing from the replace dialog of @p w, as if the user typed in it
+static KReplaceDialog *startReplace(KTextEdit &w, const QString &pattern, const QString &replacement, long options)
+{
+    if (!QMetaObject::invokeMethod(&w, "slotReplace")) {
+        return nullptr;
+    }
+    KReplaceDialog *dialog = w.findChild<KReplaceDialog *>();
+    if (!dialog) {
+        return nullptr;
+    }
+    dialog->setPattern(pattern);
+    // the second combo box is the one of the replacement
+    dialog->findChildren<QComboBox *>().at(1)->setEditText(replacement);
+    dialog->setOptions(options);
+    Q_EMIT dialog->okClicked();
+    return dialog;
+}
+
+void KTextEdit_UnitTest::testReplaceAll()
+{
+    const QString text = QStringLiteral("needle\nhay needle hay\nneedle");
+    KTextEdit w;
+    w.setPlainText(text);
+    closeMessageBoxes(&w);
+    KReplaceDialog *dialog = startReplace(w, QStringLiteral("needle"), QStringLiteral("pin"), 0);
+    QVERIFY(dialog);
+    QCOMPARE(dialog->replacement(), QStringLiteral("pin"));
+
+    QCOMPARE(w.document()->toPlainText(), QStringLiteral("pin\nhay pin hay\npin"));
+    // the cursor is left at the last replacement
+    QCOMPARE(w.textCursor().position(), 16);
+
+    // all the replacements are undone at once
+    w.undo();
+    QCOMPARE(w.document()->toPlainText(), text);
+}
+
+void KTextEdit_UnitTest::testReplaceAllBackwards()
+{
+    // Replacing backwards, a match can overlap the text replaced before it,
+    // which must then be in the document before replacing it
+    const QString text = QStringLiteral("xaab\naab");
+    KTextEdit w;
+    w.setPlainText(text);
+    closeMessageBoxes(&w);
+    QTextCursor tc = w.textCursor();
+    tc.movePosition(QTextCursor::End);
+    w.setTextCursor(tc);
+    QVERIFY(startReplace(w, QStringLiteral("ab"), QStringLiteral("b"), KFind::FindBackwards));
+
+    QCOMPARE(w.document()->toPlainText(), QStringLiteral("xb\nb"));
+    QCOMPARE(w.textCursor().position(), 1);
+
+    w.undo();
+    QCOMPARE(w.document()->toPlainText(), text);
+}
+
+void KTextEdit_UnitTest::testReplaceAllInBackground()
+{
+    const QString text = QStringLiteral("needle\nhay needle hay");
+    KTextEdit w;
+    w.setPlainText(text);
+    w.setReplaceAllInBackground(true);
+    QVERIFY(w.replaceAllInBackground());
+    closeMessageBoxes(&w);
+    QSignalSpy progress(&w, &KTextEdit::replaceAllProgress);
+    QSignalSpy finished(&w, &KTextEdit::replaceAllFinished);
+    QSignalSpy canceled(&w, &KTextEdit::replaceAllCanceled);
+    QVERIFY(startReplace(w, QStringLiteral("needle"), QStringLiteral("pin"), 0));
+
+    // nothing is replaced until all the replacements are known
+    QCOMPARE(w.document()->toPlainText(), text);
+    QTRY_COMPARE(finished.count(), 1);
+    QCOMPARE(finished.at(0).at(0).toInt(), 2);
+    QCOMPARE(canceled.count(), 0);
+    QVERIFY(!progress.isEmpty());
+    QCOMPARE(progress.last().at(0).toInt(), text.length());
+    QCOMPARE(progress.last().at(1).toInt(), text.length());
+    QCOMPARE(w.document()->toPlainText(), QStringLiteral("pin\nhay pin hay"));
+
+    w.undo();
+    QCOMPARE(w.document()->toPlainText(), text);
+}
+
+void KTextEdit_UnitTest::testReplaceAllInBackgroundCanceled()
+{
+    const QString text = QStringLiteral("needle\nhay needle hay");
+    KTextEdit w;
+    w.setPlainText(text);
+    w.setReplaceAllInBackground(true);
+    closeMessageBoxes(&w);
+    QSignalSpy finished(&w, &KTextEdit::replaceAllFinished);
+    QSignalSpy canceled(&w, &KTextEdit::replaceAllCanceled);
+
+    // the replacements found for the document as it was aren't applied to
+    // the document as it is now; it is edited before they can come back
+    QVERIFY(startReplace(w, QStringLiteral("needle"), QStringLiteral("pin"), 0));
+    QTextCursor tc = w.textCursor();
+    tc.movePosition(QTextCursor::End);
+    tc.insertText(QStringLiteral(" needle"));
+    QTRY_COMPARE(canceled.count(), 1);
+    QCOMPARE(finished.count(), 0);
+    QCOMPARE(w.document()->toPlainText(), text + QStringLiteral(" needle"));
+
+    // nor after cancelReplaceAll()
+    w.setPlainText(text);
+    QVERIFY(startReplace(w, QStringLiteral("needle"), QStringLiteral("pin"), 0));
+    w.cancelReplaceAll();
+    QTRY_COMPARE(canceled.count(), 2);
+    QCOMPARE(finished.count(), 0);
+    QCOMPARE(w.document()->toPlainText(), text);
+}
+
 // void KTextEdit_UnitTest::testImportWithVerticalTraversal()
 // {
 //     QTextEdit *te = new QTextEdit();
@@ -9,6 +9,7 @@
 
 #include "kfind.h"
 #include "kfind_p.h"
+#include "kfindmatcher_p.h"
 
 #include "kfinddialog.h"
 
@@ -16,18 +17,62 @@
 #include <KLocalizedString>
 #include <KMessageBox>
 
+#include <QCache>
 #include <QDialog>
 #include <QDialogButtonBox>
+#include <QFile>
 #include <QHash>
 #include <QLabel>
+#include <QMutex>
+#include <QPromise>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QSemaphore>
+#include <QStringDecoder>
+#include <QThreadPool>
 #include <QVBoxLayout>
 
+#include <algorithm>
+#include <atomic>
+
 // #define DEBUG_FIND
 
 static const int INDEX_NOMATCH = -1;
 
+// The options which change how a pattern is compiled into a QRegularExpression
+static const long REGEXP_COMPILE_OPTIONS = KFind::WholeWordsOnly | KFind::CaseSensitive;
+
+// The number of edits allowed by an approximate search, unless set with
+// KFind::setMaxEditDistance()
+static const int DEFAULT_MAX_EDIT_DISTANCE = 1;
+
+// Number of compiled regular expressions kept by the process-wide cache
+static const int REGEXP_CACHE_SIZE = 32;
+
+// Number of data blocks per thread scanned at once by a parallel search;
+// the scan stops after the first batch containing a candidate match
+static const int PARALLEL_BLOCKS_PER_THREAD = 4;
+
+// Number of patterns whose occurrences are kept during an incremental
+// search, so that deleting characters doesn't need a new search
+static const int INCREMENTAL_CANDIDATE_SETS = 16;
+
+// An incremental search doesn't keep the occurrences of a pattern that
+// occurs more often than this (e.g. of a single letter in a big document)
+static const qsizetype MAX_INCREMENTAL_CANDIDATES = 1 << 20;
+
+// Number of characters of a data block searched at once by a time-budgeted
+// KFind::find(), between two checks of its deadline
+static const int FIND_SLICE_SIZE = 1 << 16;
+
+// Number of bytes read (or decoded from a memory-mapped file) at once by a
+// streaming search
+static const qint64 STREAM_CHUNK_SIZE = 1 << 20;
+
+// Number of characters kept before the current position of a streaming
+// search, for lookbehind assertions of regular expressions
+static const int STREAM_REGEXP_LOOKBEHIND = 4096;
+
 class KFindNextDialog : public QDialog
 {
     Q_OBJECT
@@ -107,14 +152,14 @@ void KFindPrivate::init(const QString &_pattern)
     Q_Q(KFind);
 
     matches = 0;
+    maxEditDistance = DEFAULT_MAX_EDIT_DISTANCE;
     pattern = _pattern;
     dialog = nullptr;
     dialogClosed = false;
     index = INDEX_NOMATCH;
     lastResult = KFind::NoMatch;
 
-    // TODO: KF6 change this comment once d->regExp is removed
-    // set options and create d->regExp with the right options
+    // set options and drop any previously compiled pattern
     q->setOptions(options);
 }
 
@@ -147,6 +192,8 @@ void KFind::setData(int id, const QString &data, int startPos)
 {
     Q_D(KFind);
 
+    ++d->searchGeneration;
+
     // cache the data for incremental find
     if (d->options & KFind::FindIncremental) {
         if (id != -1) {
@@ -161,6 +208,8 @@ void KFind::setData(int id, const QString &data, int startPos)
             d->data.append(KFindPrivate::Data(id, data, true));
         } else {
             d->data.replace(id, KFindPrivate::Data(id, data, true));
+            // the occurrences found in the old data are gone
+            ++d->dataGeneration;
         }
         Q_ASSERT(d->data.at(id).text == data);
     }
@@ -190,7 +239,7 @@ QDialog *KFind::findNextDialog(bool create)
     Q_D(KFind);
 
     if (!d->dialog && create) {
-        KFindNextDialog *dialog = new KFindNextDialog(d->pattern, parentWidget());
+        KFindNextDialog *dialog = new KFindNextDialog(d->displayPattern(), parentWidget());
         connect(dialog->findButton(), &QPushButton::clicked, this, [d]() {
             d->slotFindNext();
         });
@@ -203,11 +252,20 @@ QDialog *KFind::findNextDialog(bool create)
 }
 
 KFind::Result KFind::find()
+{
+    return find(QDeadlineTimer(QDeadlineTimer::Forever));
+}
+
+KFind::Result KFind::find(QDeadlineTimer deadline)
 {
     Q_D(KFind);
 
+    ++d->searchGeneration;
+
     Q_ASSERT(d->index != INDEX_NOMATCH || d->patternChanged);
 
+    d->matchedPatternIndex = -1;
+
     if (d->lastResult == Match && !d->patternChanged) {
         // Move on before looking for the next match, _if_ we just found a match
         if (d->options & KFind::FindBackwards) {
@@ -216,23 +274,26 @@ KFind::Result KFind::find()
                 d->lastResult = NoMatch;
                 return NoMatch;
             }
+        } else if (d->isApproximate()) {
+            // approximate matches don't overlap, or a match would be followed
+            // by all its sub-matches
+            d->index += qMax(1, d->matchedLength);
         } else {
             d->index++;
         }
     }
+    // An interrupted search goes on where it stopped, with the same pattern
+    const bool resume = d->lastResult == Interrupted && !d->patternChanged;
     d->patternChanged = false;
 
-    if (d->options & KFind::FindIncremental) {
+    if (d->isIncrementalPattern() && !resume) {
         // if the current pattern is shorter than the matchedPattern we can
         // probably look up the match in the incrementalPath
         if (d->pattern.length() < d->matchedPattern.length()) {
             KFindPrivate::Match match;
-            if (!d->pattern.isEmpty()) {
-                match = d->incrementalPath.value(d->pattern);
-            } else if (d->emptyMatch) {
-                match = *d->emptyMatch;
+            if (d->matchedPattern.startsWith(d->pattern)) {
+                match = d->incrementalPath.value(d->pattern.length());
             }
-            QString previousPattern(d->matchedPattern);
             d->matchedPattern = d->pattern;
             if (!match.isNull()) {
                 bool clean = true;
@@ -241,16 +302,13 @@ KFind::Result KFind::find()
                 while (d->data.at(match.dataId).dirty == true && !d->pattern.isEmpty()) {
                     d->pattern.truncate(d->pattern.length() - 1);
 
-                    match = d->incrementalPath.value(d->pattern);
+                    match = d->incrementalPath.value(d->pattern.length());
 
                     clean = false;
                 }
 
                 // remove all matches that lie after the current match
-                while (d->pattern.length() < previousPattern.length()) {
-                    d->incrementalPath.remove(previousPattern);
-                    previousPattern.truncate(previousPattern.length() - 1);
-                }
+                d->incrementalPath.resize(qMin(d->incrementalPath.size(), d->pattern.length() + 1));
 
                 // set the current text, index, etc. to the found match
                 d->text = d->data.at(match.dataId).text;
@@ -311,38 +369,70 @@ KFind::Result KFind::find()
         // if we have multiple data blocks in our cache, walk through these
         // blocks till we either searched all blocks or we find a match
         do {
+            // Incremental search: narrow down the occurrences of the previous
+            // pattern rather than searching the data again
+            if (d->canUseCandidates()) {
+                bool interrupted = false;
+                if (d->findNextCandidate(deadline, &interrupted)) {
+                    break;
+                }
+                if (interrupted) {
+                    d->lastResult = Interrupted;
+                    return Interrupted;
+                }
+            }
+
             // Find the next candidate match.
-            d->index = KFind::find(d->text, d->pattern, d->index, d->options, &d->matchedLength, nullptr);
+            if (deadline.isForever()) {
+                d->index = d->find(d->text, d->index, &d->matchedLength, nullptr);
+            } else {
+                while (true) {
+                    int next = d->index;
+                    d->index = d->findSlice(d->text, &next, &d->matchedLength);
+                    if (d->index != -1 || next == -1) {
+                        break;
+                    }
+                    d->index = next;
+                    if (deadline.hasExpired()) {
+                        d->lastResult = Interrupted;
+                        return Interrupted;
+                    }
+                }
+            }
 
             if (d->options & KFind::FindIncremental) {
                 d->data[d->currentId].dirty = false;
             }
 
             if (d->index == -1 && d->currentId < d->data.count() - 1) {
-                d->text = d->data.at(++d->currentId).text;
+                d->currentId = d->parallelSearch ? d->nextDataWithCandidate() : d->currentId + 1;
+                d->text = d->data.at(d->currentId).text;
 
                 if (d->options & KFind::FindBackwards) {
                     d->index = d->text.length();
                 } else {
                     d->index = 0;
                 }
+                if (!deadline.isForever() && deadline.hasExpired()) {
+                    d->lastResult = Interrupted;
+                    return Interrupted;
+                }
             } else {
                 break;
             }
-        } while (!(d->options & KFind::RegularExpression));
+        } while (!(d->options & KFind::RegularExpression) || !d->patterns.isEmpty());
 
         if (d->index != -1) {
             // Flexibility: the app can add more rules to validate a possible match
             if (validateMatch(d->text, d->index, d->matchedLength)) {
                 bool done = true;
 
-                if (d->options & KFind::FindIncremental) {
-                    if (d->pattern.isEmpty()) {
-                        delete d->emptyMatch;
-                        d->emptyMatch = new KFindPrivate::Match(d->currentId, d->index, d->matchedLength);
-                    } else {
-                        d->incrementalPath.insert(d->pattern, KFindPrivate::Match(d->currentId, d->index, d->matchedLength));
+                if (d->isIncrementalPattern()) {
+                    const qsizetype length = d->pattern.length();
+                    if (d->incrementalPath.size() <= length) {
+                        d->incrementalPath.resize(length + 1);
                     }
+                    d->incrementalPath[length] = KFindPrivate::Match(d->currentId, d->index, d->matchedLength);
 
                     if (d->pattern.length() < d->matchedPattern.length()) {
                         d->pattern += QStringView(d->matchedPattern).mid(d->pattern.length(), 1);
@@ -378,7 +468,7 @@ KFind::Result KFind::find()
                 }
             }
         } else {
-            if (d->options & KFind::FindIncremental) {
+            if (d->isIncrementalPattern()) {
                 QString temp(d->pattern);
                 temp.truncate(temp.length() - 1);
                 d->pattern = d->matchedPattern;
@@ -396,57 +486,175 @@ KFind::Result KFind::find()
     return NoMatch;
 }
 
+bool KFindPrivate::isIncrementalPattern() const
+{
+    return (options & KFind::FindIncremental) && patterns.isEmpty();
+}
+
+bool KFindPrivate::isApproximate() const
+{
+    return (options & KFind::ApproximateMatch) && !(options & KFind::RegularExpression) && patterns.isEmpty();
+}
+
 void KFindPrivate::startNewIncrementalSearch()
 {
-    KFindPrivate::Match *match = emptyMatch;
-    if (match == nullptr) {
+    const KFindPrivate::Match match = incrementalPath.value(0);
+    if (match.isNull()) {
         text.clear();
         index = 0;
         currentId = 0;
     } else {
-        text = data.at(match->dataId).text;
-        index = match->index;
-        currentId = match->dataId;
+        text = data.at(match.dataId).text;
+        index = match.index;
+        currentId = match.dataId;
     }
     matchedLength = 0;
     incrementalPath.clear();
-    delete emptyMatch;
-    emptyMatch = nullptr;
     matchedPattern = pattern;
     pattern.clear();
 }
 
-static bool isInWord(QChar ch)
+bool KFindPrivate::canUseCandidates() const
 {
-    return ch.isLetter() || ch.isDigit() || ch == QLatin1Char('_');
+    // Only literal forward searches can narrow down the occurrences of a
+    // prefix: with whole words, an occurrence of "ab" in "abc" isn't one.
+    const long unsupported = KFind::RegularExpression | KFind::FindBackwards | KFind::WholeWordsOnly | KFind::ApproximateMatch | KFind::IgnoreDiacritics;
+    if (!isIncrementalPattern() || (options & unsupported) || pattern.isEmpty() || index < 0 || currentId < 0 || currentId >= data.count()) {
+        return false;
+    }
+    // The current text is the one of the current data block, unless that
+    // was replaced while searching it; then keep searching the old text.
+    return text.constData() == data.at(currentId).text.constData();
 }
 
-static bool isWholeWords(const QString &text, int starts, int matchedLength)
+const QList<KFindPrivate::Match> *KFindPrivate::candidates(QDeadlineTimer deadline, bool *interrupted)
 {
-    if (starts == 0 || !isInWord(text.at(starts - 1))) {
-        const int ends = starts + matchedLength;
-        if (ends == text.length() || !isInWord(text.at(ends))) {
-            return true;
+    *interrupted = false;
+
+    if (candidateSetsGeneration != dataGeneration) {
+        candidateSets.clear();
+        candidateSetsGeneration = dataGeneration;
+    }
+
+    const KFindLiteralMatcher &matcher = literalMatcher();
+    const Qt::CaseSensitivity caseSensitivity = matcher.caseSensitivity();
+
+    // Look for the occurrences of the pattern itself, or else of its longest prefix
+    int cached = -1;
+    for (int i = 0; i < candidateSets.count(); ++i) {
+        const CandidateSet &set = candidateSets.at(i);
+        if (set.caseSensitivity != caseSensitivity || !pattern.startsWith(set.pattern)) {
+            continue;
+        }
+        if (set.overflow) {
+            // known to occur too often, no need to search again; the
+            // occurrences of a longer pattern are searched from scratch
+            if (set.pattern.length() == pattern.length()) {
+                candidateSets.move(i, candidateSets.count() - 1);
+                return nullptr;
+            }
+            continue;
+        }
+        if (cached == -1 || set.pattern.length() > candidateSets.at(cached).pattern.length()) {
+            cached = i;
         }
     }
-    return false;
+
+    CandidateSet set;
+    if (cached != -1 && candidateSets.at(cached).pattern.length() == pattern.length()) {
+        set = candidateSets.takeAt(cached);
+    } else {
+        set.pattern = pattern;
+        set.caseSensitivity = caseSensitivity;
+        if (cached != -1) {
+            // every occurrence of the pattern is an occurrence of its prefix
+            const CandidateSet &prefix = candidateSets.at(cached);
+            for (const Match &match : prefix.matches) {
+                if (matcher.matchesAt(data.at(match.dataId).text, match.index)) {
+                    set.matches.append(Match(match.dataId, match.index, pattern.length()));
+                }
+            }
+            set.scannedData = prefix.scannedData;
+            set.scannedIndex = prefix.scannedIndex;
+        }
+    }
+
+    // Search the data blocks which weren't searched yet, as far as needed to
+    // find the next occurrence
+    auto hasNext = [this](const CandidateSet &set) {
+        if (set.matches.isEmpty()) {
+            return false;
+        }
+        const Match &last = set.matches.constLast();
+        return last.dataId > currentId || (last.dataId == currentId && last.index >= index);
+    };
+    // An expired deadline stops the search after an occurrence, or at the
+    // end of a data block, where the next call goes on.
+    bool expired = false;
+    while (set.scannedData < data.count() && !hasNext(set) && !expired) {
+        const QString &blockText = data.at(set.scannedData).text;
+        for (qsizetype pos = matcher.indexIn(blockText, set.scannedIndex); pos != -1; pos = matcher.indexIn(blockText, pos + 1)) {
+            if (set.matches.size() == MAX_INCREMENTAL_CANDIDATES) {
+                set.overflow = true;
+                set.matches = QList<Match>();
+                break;
+            }
+            set.matches.append(Match(set.scannedData, pos, pattern.length()));
+            if (deadline.hasExpired()) {
+                set.scannedIndex = int(pos + 1);
+                expired = true;
+                break;
+            }
+        }
+        if (set.overflow) {
+            break;
+        }
+        if (!expired) {
+            ++set.scannedData;
+            set.scannedIndex = 0;
+            expired = deadline.hasExpired();
+        }
+    }
+    *interrupted = !set.overflow && set.scannedData < data.count() && !hasNext(set);
+
+    if (candidateSets.count() == INCREMENTAL_CANDIDATE_SETS) {
+        candidateSets.removeFirst();
+    }
+    candidateSets.append(std::move(set));
+    const CandidateSet &last = candidateSets.constLast();
+    return last.overflow ? nullptr : &last.matches;
 }
 
-static bool matchOk(const QString &text, int index, int matchedLength, long options)
+bool KFindPrivate::findNextCandidate(QDeadlineTimer deadline, bool *interrupted)
 {
-    if (options & KFind::WholeWordsOnly) {
-        // Is the match delimited correctly?
-        if (isWholeWords(text, index, matchedLength)) {
-            return true;
-        }
+    const QList<Match> *matches = candidates(deadline, interrupted);
+    if (!matches || *interrupted) {
+        return false;
+    }
+
+    auto it = std::lower_bound(matches->cbegin(), matches->cend(), qMakePair(currentId, index), [](const Match &match, const QPair<int, int> &position) {
+        return match.dataId < position.first || (match.dataId == position.first && match.index < position.second);
+    });
+
+    // The data blocks up to the match count as searched
+    const int lastId = it == matches->cend() ? data.count() - 1 : it->dataId;
+    for (int id = currentId; id <= lastId; ++id) {
+        data[id].dirty = false;
+    }
+
+    currentId = lastId;
+    text = data.at(currentId).text;
+    if (it == matches->cend()) {
+        index = -1;
+        matchedLength = 0;
     } else {
-        // Non-whole-word search: this match is good
-        return true;
+        index = it->index;
+        matchedLength = it->matchedLength;
     }
-    return false;
+    return true;
 }
 
-static int findRegex(const QString &text, const QString &pattern, int index, long options, int *matchedLength, QRegularExpressionMatch *rmatch)
+static QRegularExpression createRegExp(const QString &pattern, long options)
 {
     QString _pattern = pattern;
 
@@ -464,13 +672,147 @@ static int findRegex(const QString &text, const QString &pattern, int index, lon
     }
 
     QRegularExpression re(_pattern, opts);
+    // Compile (and JIT-compile, where available) right away, rather than on the first match
+    re.optimize();
+    return re;
+}
+
+namespace
+{
+struct RegExpCacheKey {
+    QString pattern;
+    long options;
+
+    bool operator==(const RegExpCacheKey &other) const
+    {
+        return options == other.options && pattern == other.pattern;
+    }
+};
+
+size_t qHash(const RegExpCacheKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.pattern, key.options);
+}
+
+struct CachedRegExp {
+    QRegularExpression re;
+    KFindRegExpPrefilter prefilter;
+};
+
+struct RegExpCache {
+    QMutex mutex;
+    QCache<RegExpCacheKey, CachedRegExp> cache{REGEXP_CACHE_SIZE};
+};
+}
+
+Q_GLOBAL_STATIC(RegExpCache, s_regExpCache)
+
+// Process-wide cache of compiled regular expressions, shared by all KFind
+// instances and by the static KFind::find(); least recently used entries
+// are evicted first. The literals of the matches are looked for along with
+// the compilation, and cached with it if @p prefilter is set.
+static QRegularExpression cachedRegExp(const QString &pattern, long options, KFindRegExpPrefilter *prefilter = nullptr)
+{
+    const RegExpCacheKey key{pattern, options & REGEXP_COMPILE_OPTIONS};
+
+    RegExpCache *regExpCache = s_regExpCache();
+    QMutexLocker locker(&regExpCache->mutex);
+    if (const CachedRegExp *cached = regExpCache->cache.object(key)) {
+        if (prefilter) {
+            *prefilter = cached->prefilter;
+        }
+        return cached->re;
+    }
+    const QRegularExpression re = createRegExp(pattern, options);
+    // looking at the pattern as compiled also takes the word boundaries in
+    const Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    auto *cached = new CachedRegExp{re, KFindRegExpPrefilter(re.pattern(), caseSensitive)};
+    if (prefilter) {
+        *prefilter = cached->prefilter;
+    }
+    regExpCache->cache.insert(key, cached);
+    return re;
+}
+
+// Finds the first match of @p re starting at or after @p index. If all its
+// matches start with a literal, @p re is only tried where it occurs.
+static QRegularExpressionMatch firstRegexMatch(const QString &text, const QRegularExpression &re, const KFindRegExpPrefilter &prefilter, qsizetype index)
+{
+    const KFindLiteralMatcher &prefix = prefilter.prefix();
+    if (prefix.pattern().isEmpty() || index < 0 || index > text.size()) {
+        return re.match(text, index);
+    }
+    for (qsizetype candidate = prefix.indexIn(text, index); candidate != -1; candidate = prefix.indexIn(text, candidate + 1)) {
+        QRegularExpressionMatch match = re.match(text, candidate, QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption);
+        if (match.hasMatch()) {
+            return match;
+        }
+    }
+    return QRegularExpressionMatch();
+}
+
+// Finds the match of @p re that QRegularExpression::globalMatch() finds next
+// from @p offset, after an empty match there if @p afterEmptyMatch
+static QRegularExpressionMatch
+nextGlobalMatch(QStringView text, const QRegularExpression &re, qsizetype offset, bool afterEmptyMatch, QRegularExpression::MatchType matchType)
+{
+    QRegularExpressionMatchIterator it = re.globalMatchView(text, offset, matchType);
+    if (!it.hasNext()) {
+        return QRegularExpressionMatch();
+    }
+    QRegularExpressionMatch match = it.next();
+    if (afterEmptyMatch && match.hasMatch() && match.capturedStart(0) == offset && match.capturedLength(0) == 0) {
+        // that is the empty match found before, the iterator goes on after
+        // it the way globalMatch() does
+        match = it.hasNext() ? it.next() : QRegularExpressionMatch();
+    }
+    return match;
+}
+
+// Finds the last match of @p re starting at or before @p index, among the
+// matches of QRegularExpression::globalMatch(), which don't overlap, the
+// way QString::lastIndexOf() does.
+static QRegularExpressionMatch lastRegexMatch(const QString &text, const QRegularExpression &re, qsizetype index)
+{
+    if (index < 0) {
+        index += text.size();
+        if (index < 0) {
+            return QRegularExpressionMatch();
+        }
+    }
+
+    QRegularExpressionMatch lastMatch;
+    QRegularExpressionMatchIterator it = re.globalMatch(text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        if (match.capturedStart(0) > index) {
+            break;
+        }
+        lastMatch = std::move(match);
+    }
+    return lastMatch;
+}
+
+static int findRegex(const QString &text,
+                     const QRegularExpression &re,
+                     const KFindRegExpPrefilter &prefilter,
+                     int index,
+                     long options,
+                     int *matchedLength,
+                     QRegularExpressionMatch *rmatch)
+{
+    const bool backwards = options & KFind::FindBackwards;
     QRegularExpressionMatch match;
-    if (options & KFind::FindBackwards) {
-        // Backward search, until the beginning of the line...
-        (void)text.lastIndexOf(re, index, &match);
-    } else {
-        // Forward search, until the end of the line...
-        match = re.match(text, index);
+    const KFindLiteralMatcher &required = prefilter.required();
+    // A text without the literal that all the matches contain has none
+    if (required.pattern().isEmpty() || required.indexIn(text, backwards ? 0 : qMax(index, 0)) != -1) {
+        if (backwards) {
+            // Backward search, until the beginning of the line...
+            match = lastRegexMatch(text, re, index);
+        } else {
+            // Forward search, until the end of the line...
+            match = firstRegexMatch(text, re, prefilter, index);
+        }
     }
 
     // index is -1 if no match is found
@@ -485,62 +827,930 @@ static int findRegex(const QString &text, const QString &pattern, int index, lon
     return index;
 }
 
+const QRegularExpression &KFindPrivate::regExp()
+{
+    const long compileOptions = options & REGEXP_COMPILE_OPTIONS;
+    const QString searchPattern = this->searchPattern();
+    if (!compiledRegExpValid || compiledRegExpOptions != compileOptions || compiledRegExpPattern != searchPattern) {
+        compiledRegExp = cachedRegExp(searchPattern, compileOptions, &compiledRegExpPrefilter);
+        compiledRegExpPattern = searchPattern;
+        compiledRegExpOptions = compileOptions;
+        compiledRegExpValid = true;
+    }
+    return compiledRegExp;
+}
+
+const KFindRegExpPrefilter &KFindPrivate::regExpPrefilter()
+{
+    regExp();
+    return compiledRegExpPrefilter;
+}
+
+bool KFindPrivate::collectRegExpMatches(const QString &text, int index, qsizetype sliceSize)
+{
+    const QRegularExpression &re = regExp();
+    RegExpMatches &list = regExpMatches;
+    if (list.text.constData() != text.constData() || list.text.size() != text.size() || list.regExp != re) {
+        list = RegExpMatches();
+        list.text = text;
+        list.regExp = re;
+        // a text without the literal all the matches contain has none
+        const KFindLiteralMatcher &required = regExpPrefilter().required();
+        list.complete = !required.pattern().isEmpty() && required.indexIn(text, 0) == -1;
+    }
+
+    const qsizetype sliceStart = list.offset;
+    qsizetype slice = sliceSize;
+    while (!list.complete && (list.steps.isEmpty() || list.steps.last().start <= index)) {
+        if (sliceSize >= 0 && list.offset - sliceStart >= sliceSize) {
+            return false;
+        }
+        // A hard partial match tells when a match could go on past the
+        // slice, which is then given more text
+        const bool truncated = sliceSize >= 0 && list.offset + slice < text.size();
+        const QStringView subject = truncated ? QStringView(text).first(list.offset + slice) : QStringView(text);
+        const QRegularExpressionMatch match = nextGlobalMatch(subject,
+                                                              re,
+                                                              list.offset,
+                                                              list.afterEmptyMatch,
+                                                              truncated ? QRegularExpression::PartialPreferFirstMatch : QRegularExpression::NormalMatch);
+        if (match.hasPartialMatch()) {
+            // no match starts before the partial one, even with more text
+            if (match.capturedStart(0) > list.offset) {
+                list.offset = int(match.capturedStart(0));
+                list.afterEmptyMatch = false;
+            }
+            slice *= 2;
+            continue;
+        }
+        if (!match.hasMatch()) {
+            if (truncated) {
+                list.offset = int(subject.size());
+                list.afterEmptyMatch = false;
+            } else {
+                list.complete = true;
+            }
+            continue;
+        }
+        list.steps.append(RegExpMatches::Step{list.offset, int(match.capturedStart(0)), list.afterEmptyMatch});
+        list.offset = int(match.capturedEnd(0));
+        list.afterEmptyMatch = match.capturedLength(0) == 0;
+    }
+    return true;
+}
+
+int KFindPrivate::lastRegExpMatch(const QString &text, int index, int *matchedLength, QRegularExpressionMatch *rmatch)
+{
+    if (index < 0) {
+        index += text.size();
+    }
+    QRegularExpressionMatch match;
+    if (index >= 0) {
+        collectRegExpMatches(text, index, -1);
+        const QList<RegExpMatches::Step> &steps = regExpMatches.steps;
+        auto step = std::upper_bound(steps.cbegin(), steps.cend(), index, [](int value, const RegExpMatches::Step &candidate) {
+            return value < candidate.start;
+        });
+        if (step != steps.cbegin()) {
+            --step;
+            // find the match again from where it was found, for its captures
+            match = nextGlobalMatch(text, regExp(), step->offset, step->afterEmptyMatch, QRegularExpression::NormalMatch);
+        }
+    }
+
+    *matchedLength = match.capturedLength(0);
+    if (rmatch) {
+        *rmatch = match;
+    }
+    return match.capturedStart(0);
+}
+
+void KFindPrivate::invalidateCompiledPattern()
+{
+    compiledRegExpValid = false;
+    literalMatcherValid = false;
+    multiMatcherValid = false;
+    approximateMatcherValid = false;
+}
+
+static int findLiteral(const QString &text, const KFindLiteralMatcher &matcher, int index, long options, int *matchedLength)
+{
+    const int patternLength = matcher.pattern().length();
+    const bool wholeWords = options & KFind::WholeWordsOnly;
+
+    if (options & KFind::FindBackwards) {
+        // Backward search, until the beginning of the line
+        index = qMin(qMax(0, text.length() - patternLength), index);
+        index = wholeWords ? matcher.wholeWordLastIndexIn(text, index) : matcher.lastIndexIn(text, index);
+    } else {
+        // Forward search, until the end of the line; a negative index counts
+        // from the end, like for QString::indexOf()
+        if (index < 0) {
+            index = qMax(0, index + text.length());
+        }
+        index = wholeWords ? matcher.wholeWordIndexIn(text, index) : matcher.indexIn(text, index);
+    }
+    if (index <= -1) {
+        *matchedLength = 0;
+    } else {
+        *matchedLength = patternLength;
+    }
+    return index;
+}
+
+const KFindLiteralMatcher &KFindPrivate::literalMatcher()
+{
+    const Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const QString searchPattern = this->searchPattern();
+    if (!literalMatcherValid || compiledLiteralMatcher.caseSensitivity() != caseSensitive || compiledLiteralMatcher.pattern() != searchPattern) {
+        compiledLiteralMatcher = KFindLiteralMatcher(searchPattern, caseSensitive);
+        literalMatcherValid = true;
+    }
+    return compiledLiteralMatcher;
+}
+
+static int findMulti(const QString &text, const KFindMultiMatcher &matcher, int index, long options, int *matchedLength, int *patternIndex)
+{
+    const bool wholeWords = options & KFind::WholeWordsOnly;
+
+    KFindMultiMatcher::Match match;
+    if (options & KFind::FindBackwards) {
+        match = matcher.lastIndexIn(text, index, wholeWords);
+    } else {
+        // a negative index counts from the end, like for findLiteral()
+        if (index < 0) {
+            index = qMax(0, index + text.length());
+        }
+        match = matcher.indexIn(text, index, wholeWords);
+    }
+    *matchedLength = int(match.length);
+    if (patternIndex) {
+        *patternIndex = match.pattern;
+    }
+    return int(match.index);
+}
+
+static int findApproximate(const QString &text, const KFindApproximateMatcher &matcher, int index, long options, int *matchedLength)
+{
+    const bool wholeWords = options & KFind::WholeWordsOnly;
+
+    KFindApproximateMatcher::Match match;
+    if (options & KFind::FindBackwards) {
+        // Backward search: the match must end at or before the index, so
+        // that it doesn't overlap the one found before
+        match = matcher.lastIndexIn(text, index, wholeWords);
+    } else {
+        if (index < 0) {
+            index = qMax(0, index + text.length());
+        }
+        match = matcher.indexIn(text, index, wholeWords);
+    }
+    *matchedLength = int(match.length);
+    return int(match.index);
+}
+
+const KFindApproximateMatcher &KFindPrivate::approximateMatcher()
+{
+    const Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const QString searchPattern = this->searchPattern();
+    if (!approximateMatcherValid || compiledApproximateMatcher.caseSensitivity() != caseSensitive || compiledApproximateMatcher.pattern() != searchPattern) {
+        compiledApproximateMatcher = KFindApproximateMatcher(searchPattern, caseSensitive, maxEditDistance);
+        approximateMatcherValid = true;
+    }
+    return compiledApproximateMatcher;
+}
+
+const KFindMultiMatcher &KFindPrivate::multiMatcher()
+{
+    const Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const QStringList searchPatterns = this->searchPatterns();
+    if (!multiMatcherValid || compiledMultiMatcher.caseSensitivity() != caseSensitive || compiledMultiMatcher.patterns() != searchPatterns) {
+        compiledMultiMatcher = KFindMultiMatcher(searchPatterns, caseSensitive);
+        multiMatcherValid = true;
+    }
+    return compiledMultiMatcher;
+}
+
+QString KFindPrivate::searchPattern() const
+{
+    return (options & KFind::IgnoreDiacritics) ? KFindStrippedText::strip(pattern) : pattern;
+}
+
+QString KFindPrivate::displayPattern() const
+{
+    return patterns.isEmpty() ? pattern : patterns.join(QLatin1String(", "));
+}
+
+QStringList KFindPrivate::searchPatterns() const
+{
+    if (!(options & KFind::IgnoreDiacritics)) {
+        return patterns;
+    }
+    QStringList stripped;
+    stripped.reserve(patterns.size());
+    for (const QString &pattern : patterns) {
+        stripped.append(KFindStrippedText::strip(pattern));
+    }
+    return stripped;
+}
+
+const KFindStrippedText &KFindPrivate::strippedText(const QString &text)
+{
+    if (currentId >= 0 && currentId < data.count()) {
+        const Data &block = data.at(currentId);
+        if (block.text.constData() == text.constData() && block.text.size() == text.size()) {
+            return block.strippedText();
+        }
+    }
+    // Keeping a copy of the text means that its data can't be reused for
+    // another text as long as it is cached
+    if (strippedSource.constData() != text.constData() || strippedSource.size() != text.size()) {
+        strippedSource = text;
+        strippedCache = KFindStrippedText(text);
+    }
+    return strippedCache;
+}
+
+// Returns the index in @p stripped at which to search @p text from @p index
+static int toStrippedIndex(const KFindStrippedText &stripped, const QString &text, int index, long options)
+{
+    if (options & KFind::FindBackwards) {
+        return int(stripped.lastFromOriginal(index));
+    }
+    // a negative index counts from the end, like for findLiteral()
+    if (index < 0) {
+        index = qMax(0, index + text.length());
+    }
+    return int(stripped.fromOriginal(index));
+}
+
+// Maps a match found in @p stripped back to its original text
+static int toOriginalMatch(const KFindStrippedText &stripped, int index, int *matchedLength)
+{
+    if (index == -1) {
+        return -1;
+    }
+    const qsizetype start = stripped.toOriginal(index);
+    *matchedLength = int(stripped.toOriginal(index + *matchedLength) - start);
+    return int(start);
+}
+
+int KFindPrivate::find(const QString &text, int index, int *matchedLength, QRegularExpressionMatch *rmatch)
+{
+    if (options & KFind::IgnoreDiacritics) {
+        const KFindStrippedText &stripped = strippedText(text);
+        index = findIn(stripped.text(), toStrippedIndex(stripped, text, index, options), options, matchedLength, rmatch);
+        return toOriginalMatch(stripped, index, matchedLength);
+    }
+    return findIn(text, index, options, matchedLength, rmatch);
+}
+
+int KFindPrivate::findIn(const QString &text, int index, long searchOptions, int *matchedLength, QRegularExpressionMatch *rmatch)
+{
+    if (!patterns.isEmpty()) {
+        return findMulti(text, multiMatcher(), index, searchOptions, matchedLength, &matchedPatternIndex);
+    }
+    if (searchOptions & KFind::RegularExpression) {
+        if (searchOptions & KFind::FindBackwards) {
+            return lastRegExpMatch(text, index, matchedLength, rmatch);
+        }
+        return findRegex(text, regExp(), regExpPrefilter(), index, searchOptions, matchedLength, rmatch);
+    }
+    if (searchOptions & KFind::ApproximateMatch) {
+        return findApproximate(text, approximateMatcher(), index, searchOptions, matchedLength);
+    }
+    return findLiteral(text, literalMatcher(), index, searchOptions, matchedLength);
+}
+
+int KFindPrivate::findSlice(const QString &text, int *index, int *matchedLength)
+{
+    if (!(options & KFind::IgnoreDiacritics)) {
+        return findSliceIn(text, index, options, matchedLength);
+    }
+    // The text without diacritics is searched a slice at a time as well, the
+    // index where the search goes on being one of the original text
+    const KFindStrippedText &stripped = strippedText(text);
+    int strippedIndex = toStrippedIndex(stripped, text, *index, options);
+    const int found = findSliceIn(stripped.text(), &strippedIndex, options, matchedLength);
+    if (found != -1) {
+        return toOriginalMatch(stripped, found, matchedLength);
+    }
+    *index = strippedIndex == -1 ? -1 : int(stripped.toOriginal(strippedIndex));
+    return -1;
+}
+
+int KFindPrivate::findSliceIn(const QString &text, int *index, long searchOptions, int *matchedLength)
+{
+    const bool backwards = searchOptions & KFind::FindBackwards;
+    const bool isRegExp = (searchOptions & KFind::RegularExpression) && patterns.isEmpty();
+    // the longest match of a literal search, which needs a character of
+    // context after it for checking word boundaries
+    qsizetype maxLength = patterns.isEmpty() ? pattern.length() : 0;
+    for (const QString &searched : std::as_const(patterns)) {
+        maxLength = qMax(maxLength, searched.length());
+    }
+
+    // Approximate searches, whose best match depends on the text around it,
+    // don't stop before the end of the text
+    const qsizetype remaining = backwards ? *index : text.length() - *index;
+    if (remaining > FIND_SLICE_SIZE && (isRegExp || 2 * maxLength < FIND_SLICE_SIZE) && !isApproximate()) {
+        if (isRegExp && backwards) {
+            // The matches are collected from the start of the text, a slice
+            // at a time, until those up to the index are known
+            if (!collectRegExpMatches(text, *index, FIND_SLICE_SIZE)) {
+                *matchedLength = 0;
+                return -1;
+            }
+            const int found = lastRegExpMatch(text, *index, matchedLength, nullptr);
+            *index = -1;
+            return found;
+        }
+
+        if (isRegExp) {
+            // A hard partial match tells when a match could go on past the
+            // slice, which is then given more text
+            qsizetype sliceSize = FIND_SLICE_SIZE;
+            while (*index + sliceSize < text.length()) {
+                const QRegularExpressionMatch match =
+                    regExp().matchView(QStringView(text).first(*index + sliceSize), *index, QRegularExpression::PartialPreferFirstMatch);
+                if (match.hasMatch()) {
+                    *matchedLength = match.capturedLength(0);
+                    return match.capturedStart(0);
+                }
+                if (!match.hasPartialMatch()) {
+                    *index += sliceSize;
+                    *matchedLength = 0;
+                    return -1;
+                }
+                *index = match.capturedStart(0);
+                sliceSize *= 2;
+            }
+        } else if (backwards) {
+            // The text from the slice on, with a character of context before it
+            const int sliceStart = *index - FIND_SLICE_SIZE;
+            const QString slice = QString::fromRawData(text.constData() + sliceStart, text.length() - sliceStart);
+            const int found = findIn(slice, *index - sliceStart, searchOptions, matchedLength, nullptr);
+            if (found > 0) {
+                return sliceStart + found;
+            }
+            *index = sliceStart;
+            *matchedLength = 0;
+            return -1;
+        } else {
+            // The text up to the end of the slice, with the longest match and
+            // a character of context after it
+            const int sliceEnd = *index + FIND_SLICE_SIZE;
+            const QString slice = QString::fromRawData(text.constData(), sliceEnd);
+            const int found = findIn(slice, *index, searchOptions, matchedLength, nullptr);
+            if (found != -1 && found < sliceEnd - maxLength) {
+                return found;
+            }
+            *index = sliceEnd - maxLength;
+            *matchedLength = 0;
+            return -1;
+        }
+    }
+
+    const int found = findIn(text, *index, searchOptions, matchedLength, nullptr);
+    *index = -1;
+    return found;
+}
+
 // static
 int KFind::find(const QString &text, const QString &pattern, int index, long options, int *matchedLength, QRegularExpressionMatch *rmatch)
 {
+    if (options & KFind::IgnoreDiacritics) {
+        const KFindStrippedText stripped(text);
+        index = find(stripped.text(), KFindStrippedText::strip(pattern), toStrippedIndex(stripped, text, index, options), options & ~KFind::IgnoreDiacritics, matchedLength, rmatch);
+        return toOriginalMatch(stripped, index, matchedLength);
+    }
+
     // Handle regular expressions in the appropriate way.
     if (options & KFind::RegularExpression) {
-        return findRegex(text, pattern, index, options, matchedLength, rmatch);
+        KFindRegExpPrefilter prefilter;
+        const QRegularExpression re = cachedRegExp(pattern, options, &prefilter);
+        return findRegex(text, re, prefilter, index, options, matchedLength, rmatch);
     }
 
-    // In Qt4 QString("aaaaaa").lastIndexOf("a",6) returns -1; we need
-    // to start at text.length() - pattern.length() to give a valid index to QString.
-    if (options & KFind::FindBackwards) {
-        index = qMin(qMax(0, text.length() - pattern.length()), index);
+    const Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (options & KFind::ApproximateMatch) {
+        return findApproximate(text, KFindApproximateMatcher(pattern, caseSensitive, DEFAULT_MAX_EDIT_DISTANCE), index, options, matchedLength);
     }
+    return findLiteral(text, KFindLiteralMatcher(pattern, caseSensitive), index, options, matchedLength);
+}
 
-    Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
-
-    if (options & KFind::FindBackwards) {
-        // Backward search, until the beginning of the line...
-        while (index >= 0) {
-            // ...find the next match.
-            index = text.lastIndexOf(pattern, index, caseSensitive);
-            if (index == -1) {
-                break;
+// Appends all the matches in @p text to @p occurrences, stepping through the
+// text like consecutive calls to find() would, with find(index, &matchedLength,
+// &patternIndex) returning the next match. Unless @p overlapping, a match
+// starts after the end of the previous one. If @p q is set, the matches are
+// checked with its validateMatch().
+template<typename Find>
+static void findAllIn(const QString &text, int dataId, bool overlapping, Find find, KFind *q, QList<KFind::Occurrence> &occurrences)
+{
+    int index = 0;
+    int matchedLength = 0;
+    int patternIndex = 0;
+    while (index <= text.length()) {
+        index = find(index, &matchedLength, &patternIndex);
+        if (index == -1) {
+            break;
+        }
+        if (!q || q->validateMatch(text, index, matchedLength)) {
+            occurrences.append(KFind::Occurrence{dataId, index, matchedLength, patternIndex});
+            if (!overlapping) {
+                index += qMax(1, matchedLength);
+                continue;
             }
+        }
+        ++index;
+    }
+}
 
-            if (matchOk(text, index, pattern.length(), options)) {
-                break;
+// Maps the occurrences found in @p stripped back to its original text
+static QList<KFind::Occurrence> toOriginalOccurrences(const KFindStrippedText &stripped, QList<KFind::Occurrence> occurrences)
+{
+    for (KFind::Occurrence &occurrence : occurrences) {
+        occurrence.index = toOriginalMatch(stripped, occurrence.index, &occurrence.length);
+    }
+    return occurrences;
+}
+
+// static
+QList<KFind::Occurrence> KFind::findAll(const QString &text, const QString &pattern, long options)
+{
+    if (options & KFind::IgnoreDiacritics) {
+        const KFindStrippedText stripped(text);
+        return toOriginalOccurrences(stripped, findAll(stripped.text(), KFindStrippedText::strip(pattern), options & ~KFind::IgnoreDiacritics));
+    }
+
+    options &= ~KFind::FindBackwards;
+    QList<Occurrence> occurrences;
+    const Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    if (options & KFind::RegularExpression) {
+        KFindRegExpPrefilter prefilter;
+        const QRegularExpression re = cachedRegExp(pattern, options, &prefilter);
+        findAllIn(
+            text,
+            -1,
+            true,
+            [&](int index, int *matchedLength, int *) {
+                return findRegex(text, re, prefilter, index, options, matchedLength, nullptr);
+            },
+            nullptr,
+            occurrences);
+    } else if (options & KFind::ApproximateMatch) {
+        const KFindApproximateMatcher matcher(pattern, caseSensitive, DEFAULT_MAX_EDIT_DISTANCE);
+        findAllIn(
+            text,
+            -1,
+            false,
+            [&](int index, int *matchedLength, int *) {
+                return findApproximate(text, matcher, index, options, matchedLength);
+            },
+            nullptr,
+            occurrences);
+    } else {
+        const KFindLiteralMatcher matcher(pattern, caseSensitive);
+        findAllIn(
+            text,
+            -1,
+            true,
+            [&](int index, int *matchedLength, int *) {
+                return findLiteral(text, matcher, index, options, matchedLength);
+            },
+            nullptr,
+            occurrences);
+    }
+    return occurrences;
+}
+
+// static
+QList<KFind::Occurrence> KFind::findAll(const QString &text, const QStringList &patterns, long options)
+{
+    if (options & KFind::IgnoreDiacritics) {
+        const KFindStrippedText stripped(text);
+        QStringList strippedPatterns;
+        strippedPatterns.reserve(patterns.size());
+        for (const QString &pattern : patterns) {
+            strippedPatterns.append(KFindStrippedText::strip(pattern));
+        }
+        return toOriginalOccurrences(stripped, findAll(stripped.text(), strippedPatterns, options & ~KFind::IgnoreDiacritics));
+    }
+
+    options &= ~KFind::FindBackwards;
+    QList<Occurrence> occurrences;
+    if (!patterns.isEmpty()) {
+        const Qt::CaseSensitivity caseSensitive = (options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+        const KFindMultiMatcher matcher(patterns, caseSensitive);
+        findAllIn(
+            text,
+            -1,
+            true,
+            [&](int index, int *matchedLength, int *patternIndex) {
+                return findMulti(text, matcher, index, options, matchedLength, patternIndex);
+            },
+            nullptr,
+            occurrences);
+    }
+    return occurrences;
+}
+
+QList<KFind::Occurrence> KFind::findAll()
+{
+    Q_D(KFind);
+
+    return d->findAll();
+}
+
+QList<KFind::Occurrence> KFindPrivate::findAll(QPromise<QList<KFind::Occurrence>> *promise)
+{
+    Q_Q(KFind);
+
+    const long searchOptions = options & ~KFind::FindBackwards;
+    // finding all the matches doesn't change the state of the search
+    const int lastPatternIndex = matchedPatternIndex;
+
+    QList<KFind::Occurrence> occurrences;
+    auto findAllInText = [&](const QString &text, int dataId, const KFindStrippedText *stripped) {
+        findAllIn(
+            text,
+            dataId,
+            !isApproximate(),
+            [&](int index, int *matchedLength, int *patternIndex) {
+                if (stripped) {
+                    index = findIn(stripped->text(), toStrippedIndex(*stripped, text, index, searchOptions), searchOptions, matchedLength, nullptr);
+                    index = toOriginalMatch(*stripped, index, matchedLength);
+                } else {
+                    index = findIn(text, index, searchOptions, matchedLength, nullptr);
+                }
+                *patternIndex = qMax(0, matchedPatternIndex);
+                return index;
+            },
+            q,
+            occurrences);
+    };
+
+    const bool ignoreDiacritics = options & KFind::IgnoreDiacritics;
+    const bool allBlocks = (options & KFind::FindIncremental) && !data.isEmpty();
+    const int blockCount = allBlocks ? data.count() : 1;
+    if (promise) {
+        promise->setProgressRange(0, blockCount);
+    }
+    if (allBlocks) {
+        for (const Data &block : std::as_const(data)) {
+            if (promise) {
+                if (promise->isCanceled()) {
+                    break;
+                }
+                promise->setProgressValue(block.id);
             }
-            index--;
-            // qDebug() << "decrementing:" << index;
+            findAllInText(block.text, block.id, ignoreDiacritics ? &block.strippedText() : nullptr);
         }
     } else {
-        // Forward search, until the end of the line...
-        while (index <= text.length()) {
-            // ...find the next match.
-            index = text.indexOf(pattern, index, caseSensitive);
-            if (index == -1) {
+        findAllInText(text, currentId, ignoreDiacritics ? &strippedText(text) : nullptr);
+    }
+    if (promise && !promise->isCanceled()) {
+        promise->setProgressValue(blockCount);
+    }
+
+    matchedPatternIndex = lastPatternIndex;
+    return occurrences;
+}
+
+KFindPrivate::SearchState KFindPrivate::searchState() const
+{
+    SearchState state{pattern,
+                      patterns,
+                      options,
+                      maxEditDistance,
+                      parallelSearch,
+                      text,
+                      index,
+                      matchedLength,
+                      currentId,
+                      data,
+                      lastResult,
+                      customIds,
+                      patternChanged,
+                      matchedPattern,
+                      incrementalPath,
+                      matchedPatternIndex};
+    // the blocks build their text without diacritics when first searched,
+    // which mustn't happen to blocks shared with another thread
+    state.data.detach();
+    return state;
+}
+
+void KFindPrivate::setSearchState(const SearchState &state)
+{
+    text = state.text;
+    index = state.index;
+    matchedLength = state.matchedLength;
+    currentId = state.currentId;
+    data = state.data;
+    lastResult = state.lastResult;
+    customIds = state.customIds;
+    patternChanged = state.patternChanged;
+    matchedPattern = state.matchedPattern;
+    incrementalPath = state.incrementalPath;
+    matchedPatternIndex = state.matchedPatternIndex;
+}
+
+std::unique_ptr<KFind> KFindPrivate::createSearch(const SearchState &state)
+{
+    auto find = std::make_unique<KFind>(state.pattern, state.options, nullptr);
+    // no dialog can be shown from another thread
+    find->closeFindNextDialog();
+    if (!state.patterns.isEmpty()) {
+        find->setPatterns(state.patterns);
+    }
+    find->setMaxEditDistance(state.maxEditDistance);
+    find->setParallelSearch(state.parallelSearch);
+    find->d_func()->setSearchState(state);
+    return find;
+}
+
+QFuture<QList<KFind::Occurrence>> KFind::findAllAsync()
+{
+    Q_D(KFind);
+
+    auto promise = std::make_shared<QPromise<QList<Occurrence>>>();
+    QFuture<QList<Occurrence>> future = promise->future();
+    promise->start();
+
+    QThreadPool::globalInstance()->start([promise, state = d->searchState()]() {
+        const std::unique_ptr<KFind> find = KFindPrivate::createSearch(state);
+        const QList<Occurrence> occurrences = find->d_func()->findAll(promise.get());
+        if (!promise->isCanceled()) {
+            promise->addResult(occurrences);
+        }
+        promise->finish();
+    });
+    return future;
+}
+
+QFuture<KFind::Result> KFind::findNextAsync()
+{
+    Q_D(KFind);
+
+    auto promise = std::make_shared<QPromise<Result>>();
+    QFuture<Result> future = promise->future();
+    promise->start();
+
+    // the state the search ends in, set by the worker thread before it
+    // finishes the promise
+    auto state = std::make_shared<KFindPrivate::SearchState>(d->searchState());
+    QThreadPool::globalInstance()->start([promise, state]() {
+        const std::unique_ptr<KFind> find = KFindPrivate::createSearch(*state);
+        const Result result = find->find();
+        *state = find->d_func()->searchState();
+        promise->addResult(result);
+        promise->finish();
+    });
+
+    return future.then(this, [this, state, generation = d->searchGeneration](Result result) {
+        Q_D(KFind);
+
+        if (d->searchGeneration != generation) {
+            return result;
+        }
+        d->setSearchState(*state);
+        ++d->searchGeneration;
+        if (result == Match) {
+            d->matches++;
+            if (d->customIds) {
+                Q_EMIT textFoundAtId(d->currentId, d->index, d->matchedLength);
+            } else {
+                Q_EMIT textFound(d->text, d->index, d->matchedLength);
+            }
+        }
+        return result;
+    });
+}
+
+KFindStreamSearch::KFindStreamSearch(const QString &pattern, long options)
+    : m_pattern(pattern)
+    , m_options(options & ~(KFind::FindBackwards | KFind::FindIncremental | KFind::ApproximateMatch | KFind::IgnoreDiacritics))
+{
+}
+
+bool KFindStreamSearch::search(QIODevice *device)
+{
+    const bool isRegExp = m_options & KFind::RegularExpression;
+    const bool wholeWords = m_options & KFind::WholeWordsOnly;
+    const QRegularExpression re = isRegExp ? cachedRegExp(m_pattern, m_options) : QRegularExpression();
+    if (isRegExp && !re.isValid()) {
+        return false;
+    }
+    const Qt::CaseSensitivity caseSensitive = (m_options & KFind::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    const KFindLiteralMatcher matcher = isRegExp ? KFindLiteralMatcher() : KFindLiteralMatcher(m_pattern, caseSensitive);
+    // the text kept before the search position, for lookbehind assertions and
+    // for checking word boundaries
+    const int lookbehind = isRegExp ? STREAM_REGEXP_LOOKBEHIND : 1;
+
+    // Files are decoded straight from memory, if they can be mapped
+    QFile *file = qobject_cast<QFile *>(device);
+    uchar *mapped = nullptr;
+    qint64 mappedSize = 0;
+    qint64 mappedOffset = 0;
+    if (file && !file->isSequential() && file->size() > file->pos()) {
+        mappedSize = file->size() - file->pos();
+        mapped = file->map(file->pos(), mappedSize);
+    }
+    QByteArray buffer;
+
+    QStringDecoder decoder(QStringDecoder::Utf8);
+    QString window; // the decoded text still needed
+    qint64 windowPosition = 0; // the position of the window in the whole text
+    int index = 0; // where to search next in the window
+    int handled = 0; // the window text before this was passed to the handlers
+    bool atEnd = false;
+    bool ok = true;
+
+    while (ok && !atEnd) {
+        // Decode the next chunk
+        if (mapped) {
+            const qint64 size = qMin(STREAM_CHUNK_SIZE, mappedSize - mappedOffset);
+            const QString decoded = decoder(QByteArrayView(reinterpret_cast<const char *>(mapped) + mappedOffset, size));
+            window += decoded;
+            mappedOffset += size;
+            atEnd = mappedOffset == mappedSize;
+        } else {
+            buffer.resize(STREAM_CHUNK_SIZE);
+            qint64 size = device->read(buffer.data(), STREAM_CHUNK_SIZE);
+            if (size == 0 && device->isSequential() && device->waitForReadyRead(-1)) {
+                size = device->read(buffer.data(), STREAM_CHUNK_SIZE);
+            }
+            if (size < 0) {
+                ok = false;
                 break;
             }
+            const QString decoded = decoder(QByteArrayView(buffer.constData(), size));
+            window += decoded;
+            atEnd = size == 0;
+        }
 
-            if (matchOk(text, index, pattern.length(), options)) {
+        // Report the matches which are complete: those which more text
+        // can't change any more
+        while (ok) {
+            int matchIndex;
+            int matchedLength = 0;
+            bool partial = false;
+            QRegularExpressionMatch match;
+            if (isRegExp) {
+                // a hard partial match tells when the match could go on in the next chunk
+                match = re.match(window, index, atEnd ? QRegularExpression::NormalMatch : QRegularExpression::PartialPreferFirstMatch);
+                matchIndex = match.capturedStart(0);
+                matchedLength = match.capturedLength(0);
+                partial = match.hasPartialMatch();
+            } else {
+                matchIndex = findLiteral(window, matcher, index, m_options, &matchedLength);
+                // the word might go on in the next chunk
+                partial = matchIndex != -1 && wholeWords && !atEnd && matchIndex + matchedLength == window.length();
+            }
+
+            if (partial) {
+                index = matchIndex;
                 break;
             }
-            index++;
+            if (matchIndex == -1) {
+                if (atEnd || isRegExp) {
+                    index = qMax(index, int(window.length()));
+                } else {
+                    // an occurrence might start in the last few characters
+                    index = qMax(index, int(window.length() - m_pattern.length() + 1));
+                }
+                break;
+            }
+
+            if (!overlapping && textHandler && handled < matchIndex) {
+                ok = textHandler(QStringView(window).mid(handled, matchIndex - handled));
+            }
+            ok = ok && matchHandler(windowPosition + matchIndex, window, matchIndex, matchedLength, isRegExp ? &match : nullptr);
+            if (overlapping) {
+                index = matchIndex + 1;
+            } else {
+                handled = matchIndex + matchedLength;
+                // when the match is empty (e.g. of the empty pattern), move on
+                index = matchedLength == 0 ? handled + 1 : handled;
+            }
         }
-        if (index > text.length()) { // end of line
-            // qDebug() << "at" << index << "-> not found";
-            index = -1; // not found
+
+        // Pass the text before the search position on, and only keep what
+        // is needed to go on searching
+        const int decided = qMin(index, int(window.length()));
+        if (!overlapping && textHandler && ok && handled < decided) {
+            ok = textHandler(QStringView(window).mid(handled, decided - handled));
         }
+        handled = qMax(handled, decided);
+        const int unneeded = qMax(0, qMin(handled, index - lookbehind));
+        window.remove(0, unneeded);
+        windowPosition += unneeded;
+        index -= unneeded;
+        handled -= unneeded;
     }
-    if (index <= -1) {
-        *matchedLength = 0;
-    } else {
-        *matchedLength = pattern.length();
+
+    if (mapped) {
+        file->unmap(mapped);
+        file->seek(file->pos() + mappedOffset);
     }
-    return index;
+    return ok;
+}
+
+// static
+QList<KFind::StreamOccurrence> KFind::findAll(QIODevice *device, const QString &pattern, long options, bool *ok)
+{
+    QList<StreamOccurrence> occurrences;
+    KFindStreamSearch search(pattern, options);
+    search.matchHandler = [&occurrences](qint64 position, const QString &, int, int length, const QRegularExpressionMatch *) {
+        occurrences.append(StreamOccurrence{position, length});
+        return true;
+    };
+    const bool found = search.search(device);
+    if (ok) {
+        *ok = found;
+    }
+    return occurrences;
+}
+
+int KFindPrivate::nextDataWithCandidate()
+{
+    const int lastId = data.count() - 1;
+    int firstId = currentId + 1;
+    if (firstId >= lastId) {
+        return lastId;
+    }
+
+    // Compile the pattern here, the workers only read it
+    const bool multi = !patterns.isEmpty();
+    const bool isRegExp = !multi && (options & KFind::RegularExpression);
+    const bool approximate = isApproximate();
+    const bool ignoreDiacritics = options & KFind::IgnoreDiacritics;
+    const QRegularExpression re = isRegExp ? regExp() : QRegularExpression();
+    const KFindRegExpPrefilter prefilter = isRegExp ? regExpPrefilter() : KFindRegExpPrefilter();
+    const KFindLiteralMatcher matcher = isRegExp || multi || approximate ? KFindLiteralMatcher() : literalMatcher();
+    const KFindMultiMatcher multiMatcher = multi ? this->multiMatcher() : KFindMultiMatcher();
+    const KFindApproximateMatcher approximateMatcher = approximate ? this->approximateMatcher() : KFindApproximateMatcher();
+    const long searchOptions = options;
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int threadCount = qMax(1, pool->maxThreadCount());
+
+    // The last block is searched by find() anyway
+    while (firstId < lastId) {
+        const int batchEnd = qMin(lastId, firstId + threadCount * PARALLEL_BLOCKS_PER_THREAD);
+        QList<char> hasCandidate(batchEnd - firstId, false);
+        char *candidates = hasCandidate.data();
+        std::atomic<int> nextId(firstId);
+
+        auto scan = [&]() {
+            int id;
+            while ((id = nextId.fetch_add(1)) < batchEnd) {
+                // each block is only searched by one thread, which can
+                // build its text without diacritics
+                const KFindPrivate::Data &block = data.at(id);
+                const QString &text = ignoreDiacritics ? block.strippedText().text() : block.text;
+                const int start = (searchOptions & KFind::FindBackwards) ? text.length() : 0;
+                int matchedLength;
+                int index;
+                if (multi) {
+                    index = findMulti(text, multiMatcher, start, searchOptions, &matchedLength, nullptr);
+                } else if (isRegExp) {
+                    index = findRegex(text, re, prefilter, start, searchOptions, &matchedLength, nullptr);
+                } else if (approximate) {
+                    index = findApproximate(text, approximateMatcher, start, searchOptions, &matchedLength);
+                } else {
+                    index = findLiteral(text, matcher, start, searchOptions, &matchedLength);
+                }
+                candidates[id - firstId] = index != -1;
+            }
+        };
+
+        // The calling thread takes part in the scan, and only idle threads
+        // of the pool help, so that this never waits for unrelated work
+        QSemaphore done;
+        int helpers = 0;
+        for (int i = qMin(threadCount, batchEnd - firstId) - 1; i > 0; --i) {
+            if (!pool->tryStart([&]() {
+                    scan();
+                    done.release();
+                })) {
+                break;
+            }
+            ++helpers;
+        }
+        scan();
+        done.acquire(helpers);
+
+        for (int id = firstId; id < batchEnd; ++id) {
+            if (hasCandidate.at(id - firstId)) {
+                return id;
+            }
+            data[id].dirty = false;
+        }
+        firstId = batchEnd;
+    }
+    return lastId;
 }
 
 void KFindPrivate::slotFindNext()
@@ -572,7 +1782,7 @@ void KFind::displayFinalDialog() const
     if (numMatches()) {
         message = i18np("1 match found.", "%1 matches found.", numMatches());
     } else {
-        message = i18n("<qt>No matches found for '<b>%1</b>'.</qt>", d->pattern.toHtmlEscaped());
+        message = i18n("<qt>No matches found for '<b>%1</b>'.</qt>", d->displayPattern().toHtmlEscaped());
     }
     KMessageBox::information(dialogsParent(), message);
 }
@@ -593,7 +1803,7 @@ bool KFind::shouldRestart(bool forceAsking, bool showNumMatches) const
         if (numMatches()) {
             message = i18np("1 match found.", "%1 matches found.", numMatches());
         } else {
-            message = i18n("No matches found for '<b>%1</b>'.", d->pattern.toHtmlEscaped());
+            message = i18n("No matches found for '<b>%1</b>'.", d->displayPattern().toHtmlEscaped());
         }
     } else {
         if (d->options & KFind::FindBackwards) {
@@ -630,7 +1840,14 @@ void KFind::setOptions(long options)
 {
     Q_D(KFind);
 
+    // Flipping the direction, as KTextEdit's "Find Previous" does, doesn't
+    // change how the pattern is compiled
+    const bool directionOnly = (d->options ^ options) == FindBackwards;
     d->options = options;
+    ++d->searchGeneration;
+    if (!directionOnly) {
+        d->invalidateCompiledPattern();
+    }
 }
 
 void KFind::closeFindNextDialog()
@@ -651,6 +1868,20 @@ int KFind::index() const
     return d->index;
 }
 
+void KFind::setParallelSearch(bool parallel)
+{
+    Q_D(KFind);
+
+    d->parallelSearch = parallel;
+}
+
+bool KFind::parallelSearch() const
+{
+    Q_D(const KFind);
+
+    return d->parallelSearch;
+}
+
 QString KFind::pattern() const
 {
     Q_D(const KFind);
@@ -668,12 +1899,59 @@ void KFind::setPattern(const QString &pattern)
     }
 
     d->pattern = pattern;
+    d->patterns.clear();
+    d->matchedPatternIndex = -1;
 
-    // TODO: KF6 change this comment once d->regExp is removed
-    // set the options and rebuild d->regeExp if necessary
+    // set the options and recompile the pattern on the next search
     setOptions(options());
 }
 
+void KFind::setPatterns(const QStringList &patterns)
+{
+    Q_D(KFind);
+
+    if (d->patterns != patterns) {
+        d->patternChanged = true;
+        d->matches = 0;
+    }
+
+    d->patterns = patterns;
+    d->matchedPatternIndex = -1;
+
+    // set the options and recompile the patterns on the next search
+    setOptions(options());
+}
+
+QStringList KFind::patterns() const
+{
+    Q_D(const KFind);
+
+    return d->patterns;
+}
+
+int KFind::matchedPatternIndex() const
+{
+    Q_D(const KFind);
+
+    return d->matchedPatternIndex;
+}
+
+void KFind::setMaxEditDistance(int distance)
+{
+    Q_D(KFind);
+
+    d->maxEditDistance = distance;
+    d->approximateMatcherValid = false;
+    ++d->searchGeneration;
+}
+
+int KFind::maxEditDistance() const
+{
+    Q_D(const KFind);
+
+    return d->maxEditDistance;
+}
+
 int KFind::numMatches() const
 {
     Q_D(const KFind);
@@ -11,10 +11,15 @@
 
 #include "ktextwidgets_export.h"
 
+#include <QDeadlineTimer>
+#include <QFuture>
+#include <QList>
 #include <QObject>
+#include <QStringList>
 #include <memory>
 
 class QDialog;
+class QIODevice;
 class KFindPrivate;
 
 /**
@@ -89,6 +94,10 @@ class KFindPrivate;
  *
  *  A "Find Previous" action can simply switch temporarily the value of
  *  FindBackwards and call slotFindNext() - and reset the value afterwards.
+ *
+ *  findNextAsync() and findAllAsync() search with a plain KFind on a worker
+ *  thread, so a subclass reimplementing validateMatch() should use find()
+ *  and findAll() instead, which call it for every candidate match.
  */
 class KTEXTWIDGETS_EXPORT KFind : public QObject
 {
@@ -106,7 +115,21 @@ public:
         FindBackwards = 16, ///< Go backwards.
         RegularExpression = 32, ///< Interpret the pattern as a regular expression.
         FindIncremental = 64, ///< Find incremental.
+        /**
+         * Also find the text which differs from the pattern by a few
+         * characters, see setMaxEditDistance(). Ignored with RegularExpression.
+         * @since 6.13
+         */
+        ApproximateMatch = 128,
         // Note that KReplaceDialog uses 256 and 512
+        /**
+         * Ignore diacritics and how characters are normalized, e.g. find
+         * "résumé", whether precomposed or not, when looking for "resume",
+         * and the other way around. The matches are reported at their
+         * position in the searched text.
+         * @since 6.13
+         */
+        IgnoreDiacritics = 1024,
         // User extensions can use boolean options above this value.
         MinimumUserOption = 65536, ///< user options start with this bit
     };
@@ -133,6 +156,36 @@ public:
     enum Result {
         NoMatch,
         Match,
+        /**
+         * find(QDeadlineTimer) ran out of time before it could tell whether
+         * there is a match; calling it again goes on with the search where
+         * it stopped.
+         *
+         * @since 6.13
+         */
+        Interrupted,
+    };
+
+    /**
+     * A match found by findAll().
+     *
+     * @since 6.13
+     */
+    struct Occurrence {
+        int dataId; ///< The id of the data block the match is in, see setData(int, const QString &, int); -1 for the static findAll()
+        int index; ///< The index of the match in its data block
+        int length; ///< The length of the match
+        int patternIndex; ///< The index of the pattern found in the list of patterns searched, see setPatterns(); 0 when searching for a single pattern
+    };
+
+    /**
+     * A match found by findAll(QIODevice *, const QString &, long, bool *).
+     *
+     * @since 6.13
+     */
+    struct StreamOccurrence {
+        qint64 index; ///< The index of the match in the text read from the device, in UTF-16 code units
+        int length; ///< The length of the match
     };
 
     /**
@@ -175,6 +228,61 @@ public:
      */
     Result find();
 
+    /**
+     * Same as find(), but gives up when @p deadline expires, returning
+     * Interrupted. Call it again, e.g. after processing the pending events,
+     * to go on with the search where it stopped; setting another pattern
+     * starts a new search instead.
+     *
+     * The data is searched in slices of a bounded size, checking the deadline
+     * in between, so that searching a long text, or many of them, doesn't
+     * block the event loop for long. Some progress is always made, even
+     * if @p deadline has already expired.
+     *
+     * Some searches still take as long as a data block needs: with
+     * KFind::ApproximateMatch, each data block is searched at once, and with
+     * KFind::IgnoreDiacritics, the diacritics of a data block are all
+     * removed when it is first searched, before searching it in slices.
+     *
+     * @code
+     * KFind::Result res = m_find->find(QDeadlineTimer(20));
+     * if (res == KFind::Interrupted) {
+     *     QTimer::singleShot(0, this, &MyEditor::slotFindNext);
+     *     return;
+     * }
+     * @endcode
+     *
+     * @since 6.13
+     */
+    Result find(QDeadlineTimer deadline);
+
+    /**
+     * Same as find(), but searches on a worker thread, over a copy of the
+     * data passed to setData(), and returns at once.
+     *
+     * Once the search is over, in the thread of this KFind, the search moves
+     * on to the match found and textFound() or textFoundAtId() is emitted,
+     * as by find(), and then the returned future gets the result. If the
+     * search was changed meanwhile, e.g. by setData(), setPattern() or
+     * find(), the result is only reported by the future. The find next
+     * dialog isn't shown.
+     *
+     * @warning The worker thread searches with a plain KFind, so
+     * reimplementations of validateMatch() aren't called, and the match found
+     * can be one they would reject; use find() in that case.
+     *
+     * @code
+     * m_find->findNextAsync().then(this, [this](KFind::Result result) {
+     *     if (result == KFind::NoMatch) {
+     *         // ask for the next data, or display the final dialog
+     *     }
+     * });
+     * @endcode
+     *
+     * @since 6.13
+     */
+    QFuture<Result> findNextAsync();
+
     /**
      * Return the current options.
      *
@@ -194,6 +302,56 @@ public:
      */
     virtual void setOptions(long options);
 
+    /**
+     * Enables searching the data blocks in parallel.
+     *
+     * With the KFind::FindIncremental option, find() searches the data blocks
+     * passed to setData() one after another. When parallel search is enabled,
+     * the blocks following the current one are first scanned on the global
+     * QThreadPool, and find() then skips those which can't contain a match.
+     * The matches are still reported in the order of the ids, and
+     * validateMatch() is still called from the thread calling find(), so the
+     * matches found and their number are the same as without parallel search.
+     *
+     * This is worth enabling when searching many data blocks, e.g. the bodies
+     * of hundreds of messages. It is disabled by default.
+     *
+     * @since 6.13
+     */
+    void setParallelSearch(bool parallel);
+
+    /**
+     * @return whether the data blocks are searched in parallel
+     * @see setParallelSearch()
+     * @since 6.13
+     */
+    bool parallelSearch() const;
+
+    /**
+     * Sets how different from the pattern the text found by a search with
+     * the KFind::ApproximateMatch option may be, as the number of characters
+     * to insert, remove or replace to turn it into the pattern. It is
+     * limited to less than the length of the pattern.
+     *
+     * The text is scanned once, in time proportional to its length times
+     * the length of the pattern divided by 64, whatever the distance.
+     * Of overlapping candidates, the closest one is found, and successive
+     * matches don't overlap. With KFind::FindBackwards, a match ends at or
+     * before the index searched from, instead of starting there.
+     *
+     * The default is 1, which is also used by the static find() and findAll().
+     *
+     * @since 6.13
+     */
+    void setMaxEditDistance(int distance);
+
+    /**
+     * @return the number of edits allowed by an approximate search
+     * @see setMaxEditDistance()
+     * @since 6.13
+     */
+    int maxEditDistance() const;
+
     /**
      * @return the pattern we're currently looking for
      */
@@ -201,9 +359,47 @@ public:
 
     /**
      * Change the pattern we're looking for
+     *
+     * This also ends searching for the patterns set by setPatterns().
      */
     void setPattern(const QString &pattern);
 
+    /**
+     * Look for any of @p patterns at once, instead of for a single pattern.
+     *
+     * The text is searched in a single pass whatever the number of patterns,
+     * which is much faster than a search for each of them, or than a regular
+     * expression matching any of them, e.g. for a list of forbidden words.
+     * The patterns are always literal text, the KFind::RegularExpression
+     * option is ignored; the other options apply to all of them. Where
+     * several patterns match at the same index, the longest one is found.
+     *
+     * The matches are reported by textFound() and textFoundAtId() as usual,
+     * and matchedPatternIndex() tells which pattern was found. pattern() is
+     * left unchanged, the dialogs show the patterns separated by commas.
+     *
+     * An empty list goes back to looking for pattern().
+     *
+     * @since 6.13
+     */
+    void setPatterns(const QStringList &patterns);
+
+    /**
+     * @return the patterns we're looking for, or an empty list when looking
+     * for a single pattern
+     * @see setPatterns()
+     * @since 6.13
+     */
+    QStringList patterns() const;
+
+    /**
+     * @return the index in patterns() of the pattern of the last match found,
+     * also while the textFound() or textFoundAtId() signal is emitted for it;
+     * -1 if the last search found nothing or when looking for a single pattern
+     * @since 6.13
+     */
+    int matchedPatternIndex() const;
+
     /**
      * Returns the number of matches found (i.e. the number of times the textFound()
      * signal was emitted).
@@ -226,6 +422,9 @@ public:
      * if the find dialog extension has been used to provide additional
      * criteria.
      *
+     * It is called by find() and findAll(), but not by findNextAsync() and
+     * findAllAsync(), which search on a worker thread.
+     *
      * @param text  The current text fragment
      * @param index The starting index where the candidate match was found
      * @param matchedlength The length of the candidate match
@@ -271,6 +470,96 @@ public:
      */
     static int find(const QString &text, const QString &pattern, int index, long options, int *matchedLength, QRegularExpressionMatch *rmatch);
 
+    /**
+     * Search @p text for all the matches of @p pattern at once, with the same
+     * options, and the same matches, as find(const QString &, const QString &, int, long, int *, QRegularExpressionMatch *)
+     * would find one after another starting from the beginning of @p text.
+     *
+     * The matches are returned in the order they appear in @p text, even with
+     * the KFind::FindBackwards option.
+     *
+     * @param text The string to search in
+     * @param pattern The pattern to search for
+     * @param options The options to use
+     * @return All the matches found, with a dataId of -1
+     *
+     * @since 6.13
+     */
+    static QList<Occurrence> findAll(const QString &text, const QString &pattern, long options);
+
+    /**
+     * Search @p text for all the matches of any of @p patterns at once, in a
+     * single pass. The patterns are literal text, as for setPatterns().
+     *
+     * @param text The string to search in
+     * @param patterns The patterns to search for
+     * @param options The options to use; KFind::RegularExpression is ignored
+     * @return All the matches found, in the order they appear in @p text,
+     *         with a dataId of -1 and the index of the pattern found
+     *
+     * @since 6.13
+     */
+    static QList<Occurrence> findAll(const QString &text, const QStringList &patterns, long options);
+
+    /**
+     * Search the UTF-8 encoded text of @p device, from its current position to
+     * its end, for all the matches of @p pattern.
+     *
+     * The text is read and searched in chunks, so that only the part of it
+     * which might still be matched is kept in memory, whatever the size of
+     * the device. Files are memory-mapped when possible instead of being read.
+     * The matches are those of findAll(const QString &, const QString &, long)
+     * on the whole text, except that regular expressions can only look back
+     * a few thousand characters before the position being searched, and that
+     * a regular expression matching a very long text needs all of it at once.
+     * The FindBackwards, ApproximateMatch and IgnoreDiacritics options are ignored.
+     *
+     * @param device The device to read, open for reading
+     * @param pattern The pattern to look for
+     * @param options The options to use
+     * @param ok If set, false is stored there if the pattern is an invalid
+     *        regular expression or if reading failed, true otherwise
+     * @return the matches, in order
+     *
+     * @since 6.13
+     */
+    static QList<StreamOccurrence> findAll(QIODevice *device, const QString &pattern, long options, bool *ok = nullptr);
+
+    /**
+     * Search the current data for all the matches of the pattern at once.
+     *
+     * With the KFind::FindIncremental option, all the data blocks passed to
+     * setData() are searched, otherwise just the last one. Each of them is
+     * searched as a whole, regardless of the @c startPos passed to setData().
+     * Candidate matches are checked with validateMatch(), like for find().
+     *
+     * This doesn't change the state of the search, doesn't emit textFound()
+     * and isn't counted in numMatches(), so it is suitable for highlighting
+     * or counting all the matches, at the cost of a single scan of the data.
+     *
+     * @return All the matches found, ordered by data block and index
+     *
+     * @since 6.13
+     */
+    QList<Occurrence> findAll();
+
+    /**
+     * Same as findAll(), but searches on a worker thread, over a copy of the
+     * data passed to setData(), and returns at once. Several such searches
+     * can run at the same time, with any patterns and options.
+     *
+     * The returned future reports its progress as the number of data blocks
+     * searched, and stops searching when canceled, in which case it has no
+     * result.
+     *
+     * @warning The worker thread searches with a plain KFind, so
+     * reimplementations of validateMatch() aren't called, and the result can
+     * contain matches they would reject; use findAll() in that case.
+     *
+     * @since 6.13
+     */
+    QFuture<QList<Occurrence>> findAllAsync();
+
     /**
      * Displays the final dialog saying "no match was found", if that was the case.
      * Call either this or shouldRestart().
@@ -374,5 +663,7 @@ private:
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(KFind::SearchOptions)
+Q_DECLARE_TYPEINFO(KFind::Occurrence, Q_PRIMITIVE_TYPE);
+Q_DECLARE_TYPEINFO(KFind::StreamOccurrence, Q_PRIMITIVE_TYPE);
 
 #endif
@@ -11,12 +11,53 @@
 #define KFIND_P_H
 
 #include "kfind.h"
+#include "kfindmatcher_p.h"
 
 #include <QDialog>
-#include <QHash>
 #include <QList>
 #include <QPointer>
+#include <QPromise>
+#include <QRegularExpression>
 #include <QString>
+#include <QStringList>
+
+#include <functional>
+#include <memory>
+
+class QIODevice;
+
+/**
+ * @internal
+ *
+ * Searches the UTF-8 encoded text of a QIODevice, chunk by chunk, for the
+ * streaming KFind::findAll() and KReplace::replaceAll(). Only the text which
+ * might still be part of a match, plus a bit of context before it, is kept.
+ */
+class KFindStreamSearch
+{
+public:
+    KFindStreamSearch(const QString &pattern, long options);
+
+    /**
+     * Searches @p device from its current position to its end.
+     * Returns false if the pattern isn't valid, if reading failed or if a
+     * handler returned false.
+     */
+    bool search(QIODevice *device);
+
+    // Whether the matches may overlap, like for consecutive calls to
+    // KFind::find(), or follow each other, like for a Replace All
+    bool overlapping = true;
+    // Called with the text between the matches, in order, when they don't overlap
+    std::function<bool(QStringView text)> textHandler;
+    // Called for each match, with its position in the whole text, and its
+    // index in the text given
+    std::function<bool(qint64 position, const QString &text, int index, int length, const QRegularExpressionMatch *match)> matchHandler;
+
+private:
+    QString m_pattern;
+    long m_options;
+};
 
 class KFindPrivate
 {
@@ -30,7 +71,6 @@ public:
         , customIds(false)
         , patternChanged(false)
         , matchedPattern(QLatin1String(""))
-        , emptyMatch(nullptr)
     {
     }
 
@@ -41,8 +81,6 @@ public:
         }
         dialog = nullptr;
         data.clear();
-        delete emptyMatch;
-        emptyMatch = nullptr;
     }
 
     struct Match {
@@ -80,14 +118,219 @@ public:
         {
         }
 
+        // The text without its diacritics, built when first needed and kept
+        // until the block is replaced
+        const KFindStrippedText &strippedText() const
+        {
+            if (!stripped) {
+                stripped = std::make_shared<const KFindStrippedText>(text);
+            }
+            return *stripped;
+        }
+
         QString text;
         int id = -1;
         bool dirty = false;
+        mutable std::shared_ptr<const KFindStrippedText> stripped;
+    };
+
+    // All the occurrences of a pattern in the data blocks, as found by an
+    // incremental search
+    struct CandidateSet {
+        QString pattern;
+        Qt::CaseSensitivity caseSensitivity;
+        int scannedData = 0; // number of data blocks searched so far
+        int scannedIndex = 0; // where to go on searching the next one
+        // whether the pattern occurs too often for its occurrences to be
+        // kept, in which case there are none
+        bool overflow = false;
+        QList<Match> matches; // ordered by dataId and index
     };
 
     void init(const QString &pattern);
+    /**
+     * Whether the pattern is searched for as it is typed, each change of it
+     * going on from the matches of the previous one: with the
+     * KFind::FindIncremental option, unless looking for several patterns.
+     */
+    bool isIncrementalPattern() const;
+    /**
+     * Whether the search is an approximate one, see KFind::ApproximateMatch
+     */
+    bool isApproximate() const;
     void startNewIncrementalSearch();
 
+    /**
+     * Whether an incremental search can look up the next match among the
+     * occurrences of the current pattern, see findNextCandidate().
+     */
+    bool canUseCandidates() const;
+    /**
+     * Returns the occurrences of the current pattern, filtering those of
+     * the longest cached prefix of it rather than searching the data again,
+     * or nullptr if there are too many of them to be worth keeping.
+     * The data blocks are only searched as far as the first occurrence at
+     * or after the current position, or until @p deadline expires, which
+     * sets @p interrupted if that occurrence wasn't found yet.
+     */
+    const QList<Match> *candidates(QDeadlineTimer deadline, bool *interrupted);
+    /**
+     * Moves to the first occurrence of the current pattern at or after the
+     * current position, in this data block or a following one, or sets the
+     * index to -1 in the last data block if there is none.
+     * Returns false if the occurrences aren't available, or if @p deadline
+     * expired before the next one was found, setting @p interrupted.
+     */
+    bool findNextCandidate(QDeadlineTimer deadline, bool *interrupted);
+
+    /**
+     * Returns the regular expression for the current pattern and options,
+     * compiling it only when either of them changed since the last call.
+     */
+    const QRegularExpression &regExp();
+    /**
+     * Returns the literals of the matches of regExp(), as found when it was
+     * compiled.
+     */
+    const KFindRegExpPrefilter &regExpPrefilter();
+    /**
+     * Returns the matcher for the current (non regular expression) pattern,
+     * rebuilding it only when the pattern or the case sensitivity changed.
+     */
+    const KFindLiteralMatcher &literalMatcher();
+    /**
+     * Returns the matcher for the patterns set by setPatterns(), rebuilding
+     * it only when they or the case sensitivity changed.
+     */
+    const KFindMultiMatcher &multiMatcher();
+    /**
+     * Returns the matcher for an approximate search for the current pattern,
+     * rebuilding it only when the pattern or the case sensitivity changed.
+     */
+    const KFindApproximateMatcher &approximateMatcher();
+    void invalidateCompiledPattern();
+
+    /**
+     * The pattern, or patterns, as searched for, i.e. without diacritics with
+     * the KFind::IgnoreDiacritics option
+     */
+    QString searchPattern() const;
+    QStringList searchPatterns() const;
+    /**
+     * The pattern, or patterns separated by commas, as shown to the user
+     */
+    QString displayPattern() const;
+    /**
+     * Returns @p text without its diacritics, as cached by its data block if
+     * it is the text of the current one, or else by the last call.
+     */
+    const KFindStrippedText &strippedText(const QString &text);
+
+    /**
+     * Same as the static KFind::find(), but reuses the compiled pattern
+     * of this KFind instead of compiling it again for every call.
+     */
+    int find(const QString &text, int index, int *matchedLength, QRegularExpressionMatch *rmatch);
+    /**
+     * Same as find(), with other options, and without looking for a text
+     * without diacritics.
+     */
+    int findIn(const QString &text, int index, long searchOptions, int *matchedLength, QRegularExpressionMatch *rmatch);
+    /**
+     * Same as find(), but only looks for the matches starting in the next
+     * slice of @p text from @p index on (or back from it, with the
+     * KFind::FindBackwards option). If there is none, returns -1 and sets
+     * @p index to where the search goes on, or to -1 at the end of the text.
+     */
+    int findSlice(const QString &text, int *index, int *matchedLength);
+    /**
+     * Same as findSlice(), with other options, and without looking for a
+     * text without diacritics.
+     */
+    int findSliceIn(const QString &text, int *index, long searchOptions, int *matchedLength);
+
+    /**
+     * The matches of regExp() in a text, as found by
+     * QRegularExpression::globalMatch(): a backward search finds the last
+     * of them starting at or before its index, like QString::lastIndexOf()
+     * does, so they don't overlap. They are collected going forward, only
+     * as far as needed, and kept for stepping back through the same text.
+     */
+    struct RegExpMatches {
+        // where a match was looked for, for finding it again
+        struct Step {
+            int offset;
+            int start;
+            bool afterEmptyMatch;
+        };
+        QString text; // shares its data with the text searched
+        QRegularExpression regExp;
+        QList<Step> steps;
+        int offset = 0; // where to look for the next match
+        bool afterEmptyMatch = false;
+        bool complete = false;
+    };
+    /**
+     * Collects the matches of regExp() in @p text until one starts after
+     * @p index. With a @p sliceSize other than -1, stops after searching
+     * that many more characters and returns false if that wasn't enough.
+     */
+    bool collectRegExpMatches(const QString &text, int index, qsizetype sliceSize);
+    /**
+     * Backward search for regExp() in @p text, among the matches collected
+     * by collectRegExpMatches()
+     */
+    int lastRegExpMatch(const QString &text, int index, int *matchedLength, QRegularExpressionMatch *rmatch);
+
+    /**
+     * Same as KFind::findAll(). With @p promise, checks whether it was
+     * canceled and reports the number of data blocks searched.
+     */
+    QList<KFind::Occurrence> findAll(QPromise<QList<KFind::Occurrence>> *promise = nullptr);
+
+    /**
+     * What is searched, and where the search is, for going on with it on
+     * another thread with a private KFind, and back
+     */
+    struct SearchState {
+        QString pattern;
+        QStringList patterns;
+        long options;
+        int maxEditDistance;
+        bool parallelSearch;
+        QString text;
+        int index;
+        int matchedLength;
+        int currentId;
+        QList<Data> data;
+        KFind::Result lastResult;
+        bool customIds;
+        bool patternChanged;
+        QString matchedPattern;
+        QList<Match> incrementalPath;
+        int matchedPatternIndex;
+    };
+    SearchState searchState() const;
+    /**
+     * Sets the position of the search, i.e. all of @p state but the pattern
+     * and the options
+     */
+    void setSearchState(const SearchState &state);
+    /**
+     * Creates a KFind, which lives in the calling thread, for going on with
+     * the search of @p state. It is a plain KFind: the validateMatch() of the
+     * KFind the state was taken from isn't called.
+     */
+    static std::unique_ptr<KFind> createSearch(const SearchState &state);
+
+    /**
+     * Scans the data blocks following the current one on the thread pool,
+     * in batches, and returns the id of the first one which might contain
+     * a match (or of the last one). The blocks before it are marked as not
+     * dirty, like find() does after searching them.
+     */
+    int nextDataWithCandidate();
+
     void slotFindNext();
     void slotDialogClosed();
 
@@ -97,20 +340,56 @@ public:
     bool customIds : 1;
     bool patternChanged : 1;
     QString matchedPattern;
-    QHash<QString, Match> incrementalPath;
-    Match *emptyMatch;
+    // the match of each prefix of matchedPattern, indexed by the prefix
+    // length (so the match of the empty pattern comes first); a null Match
+    // where there is none
+    QList<Match> incrementalPath;
     QList<Data> data; // used like a vector, not like a linked-list
+    // the occurrences of the last searched incremental patterns, most recently
+    // used last, valid as long as no data block is replaced
+    QList<CandidateSet> candidateSets;
+    unsigned dataGeneration = 0;
+    unsigned candidateSetsGeneration = 0;
+    // changed by anything that changes the search, so that the result of
+    // findNextAsync() is only applied if there was nothing of the sort
+    unsigned searchGeneration = 0;
 
     QString pattern;
     QDialog *dialog;
     long options;
+
+    // cache for regExp(), keyed on the pattern and options it was compiled for
+    QRegularExpression compiledRegExp;
+    QString compiledRegExpPattern;
+    long compiledRegExpOptions = 0;
+    bool compiledRegExpValid = false;
+    KFindRegExpPrefilter compiledRegExpPrefilter;
+    // cache for literalMatcher()
+    KFindLiteralMatcher compiledLiteralMatcher;
+    bool literalMatcherValid = false;
+    // the patterns set by setPatterns(), searched instead of pattern unless empty
+    QStringList patterns;
+    // cache for multiMatcher()
+    KFindMultiMatcher compiledMultiMatcher;
+    bool multiMatcherValid = false;
+    int matchedPatternIndex = -1;
+    // cache for approximateMatcher()
+    KFindApproximateMatcher compiledApproximateMatcher;
+    bool approximateMatcherValid = false;
+    int maxEditDistance;
+    // cache for strippedText(), for a text which isn't the one of a data block
+    QString strippedSource;
+    KFindStrippedText strippedCache;
+    // cache for lastRegExpMatch()
+    RegExpMatches regExpMatches;
     unsigned matches;
 
     QString text; // the text set by setData
     int index;
     int matchedLength;
     bool dialogClosed : 1;
-    bool lastResult : 1;
+    KFind::Result lastResult;
+    bool parallelSearch = false;
 };
 
 #endif // KFIND_P_H
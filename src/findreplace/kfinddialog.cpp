@@ -525,10 +525,11 @@ void KFindDialogPrivate::showPatterns()
 class PlaceHolderAction : public QAction
 {
 public:
-    PlaceHolderAction(QObject *parent, const QString &text, int id)
+    PlaceHolderAction(QObject *parent, const QString &text, int id, const QString &name = QString())
         : QAction(text, parent)
         , mText(text)
         , mId(id)
+        , mName(name)
     {
     }
 
@@ -540,10 +541,16 @@ public:
     {
         return mId;
     }
+    // the placeholder to insert into the replacement, by name for named groups
+    QString placeholder() const
+    {
+        return mName.isEmpty() ? QStringLiteral("\\%1").arg(mId) : QStringLiteral("\\g{%1}").arg(mName);
+    }
 
 private:
     QString mText;
     int mId;
+    QString mName;
 };
 
 // Create a popup menu with a list of backreference terms, to help the user
@@ -566,7 +573,7 @@ void KFindDialogPrivate::showPlaceholders()
         PlaceHolderAction *placeHolderAction = static_cast<PlaceHolderAction *>(action);
         if (placeHolderAction) {
             QLineEdit *editor = replace->lineEdit();
-            editor->insert(QStringLiteral("\\%1").arg(placeHolderAction->id()));
+            editor->insert(placeHolderAction->placeholder());
         }
     }
 }
@@ -578,9 +585,16 @@ void KFindDialogPrivate::slotPlaceholdersAboutToShow()
     placeholders->clear();
     placeholders->addAction(new PlaceHolderAction(placeholders, i18n("Complete Match"), 0));
 
-    const int n = QRegularExpression(q->pattern(), QRegularExpression::UseUnicodePropertiesOption).captureCount();
+    const QRegularExpression re(q->pattern(), QRegularExpression::UseUnicodePropertiesOption);
+    const int n = re.captureCount();
+    const QStringList names = re.namedCaptureGroups();
     for (int i = 1; i <= n; ++i) {
-        placeholders->addAction(new PlaceHolderAction(placeholders, i18n("Captured Text (%1)", i), i));
+        const QString name = names.value(i);
+        if (name.isEmpty()) {
+            placeholders->addAction(new PlaceHolderAction(placeholders, i18n("Captured Text (%1)", i), i));
+        } else {
+            placeholders->addAction(new PlaceHolderAction(placeholders, i18n("Captured Text (%1: %2)", i, name), i, name));
+        }
     }
 }
 
@@ -0,0 +1,1299 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#include "kfindmatcher_p.h"
+
+#include <QHash>
+#include <QVarLengthArray>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Patterns longer than this are searched with Horspool, whose skips then
+// beat the SIMD first-and-last-character filter
+static const qsizetype HORSPOOL_MIN_LENGTH = 16;
+
+static bool isInWord(QChar ch)
+{
+    return ch.isLetter() || ch.isDigit() || ch == QLatin1Char('_');
+}
+
+// Simple case folding of a single code unit, with a fast path for ASCII
+static char16_t foldUnit(char16_t unit)
+{
+    if (unit < 0x80) {
+        return (unit >= u'A' && unit <= u'Z') ? char16_t(unit + 0x20) : unit;
+    }
+    return char16_t(QChar::toCaseFolded(char32_t(unit)));
+}
+
+// Simple case folding of the code unit at @p index in @p text. Surrogate
+// pairs are folded as a whole, and the matching half of the result is
+// returned, so that folding never changes the length of a text and offsets
+// into the folded text are valid for the original one.
+static char16_t foldedUnitAt(QStringView text, qsizetype index)
+{
+    const char16_t unit = text.utf16()[index];
+    if (unit < 0x80 || !QChar::isSurrogate(unit)) {
+        return foldUnit(unit);
+    }
+
+    char32_t ucs4;
+    if (QChar::isHighSurrogate(unit) && index + 1 < text.size() && QChar::isLowSurrogate(text.utf16()[index + 1])) {
+        ucs4 = QChar::surrogateToUcs4(unit, text.utf16()[index + 1]);
+    } else if (QChar::isLowSurrogate(unit) && index > 0 && QChar::isHighSurrogate(text.utf16()[index - 1])) {
+        ucs4 = QChar::surrogateToUcs4(text.utf16()[index - 1], unit);
+    } else {
+        return unit;
+    }
+
+    const char32_t folded = QChar::toCaseFolded(ucs4);
+    if (!QChar::requiresSurrogates(folded)) {
+        return unit;
+    }
+    return QChar::isHighSurrogate(unit) ? QChar::highSurrogate(folded) : QChar::lowSurrogate(folded);
+}
+
+namespace
+{
+// The non-ASCII code units which fold to each ASCII code unit
+// (e.g. U+212A KELVIN SIGN folds to 'k')
+struct AsciiFoldingSources {
+    AsciiFoldingSources()
+    {
+        for (char32_t unit = 0x80; unit <= 0xffff; ++unit) {
+            if (QChar::isSurrogate(unit)) {
+                continue;
+            }
+            const char16_t folded = foldUnit(char16_t(unit));
+            if (folded < 0x80) {
+                if (count[folded] < MaxSources) {
+                    sources[folded][count[folded]] = char16_t(unit);
+                }
+                ++count[folded];
+            }
+        }
+    }
+
+    static constexpr int MaxSources = 2;
+    char16_t sources[0x80][MaxSources] = {};
+    int count[0x80] = {};
+};
+}
+
+static const AsciiFoldingSources &asciiFoldingSources()
+{
+    static const AsciiFoldingSources sources;
+    return sources;
+}
+
+// Collects all the code units which fold to @p folded into @p variants and
+// returns their number, or 0 if @p folded isn't ASCII or they don't fit
+template<size_t Size>
+static int foldingVariants(char16_t folded, std::array<char16_t, Size> &variants)
+{
+    if (folded >= 0x80) {
+        return 0;
+    }
+    int count = 0;
+    variants[count++] = folded;
+    if (folded >= u'a' && folded <= u'z') {
+        variants[count++] = char16_t(folded - 0x20);
+    }
+
+    const AsciiFoldingSources &sources = asciiFoldingSources();
+    if (count + sources.count[folded] > int(Size)) {
+        return 0;
+    }
+    for (int i = 0; i < sources.count[folded]; ++i) {
+        variants[count++] = sources.sources[folded][i];
+    }
+    return count;
+}
+
+KFindLiteralMatcher::KFindLiteralMatcher(const QString &pattern, Qt::CaseSensitivity cs)
+    : m_pattern(pattern)
+    , m_searchPattern(pattern)
+    , m_cs(cs)
+{
+    const qsizetype length = m_pattern.size();
+
+    if (m_cs == Qt::CaseInsensitive) {
+        // Fold the pattern once here, so that searching only has to fold the text
+        m_searchPattern = QString(length, Qt::Uninitialized);
+        char16_t *folded = reinterpret_cast<char16_t *>(m_searchPattern.data());
+        for (qsizetype i = 0; i < length; ++i) {
+            folded[i] = foldedUnitAt(m_pattern, i);
+        }
+    }
+
+    const char16_t *p = m_searchPattern.utf16();
+
+    // forward: distance from the last occurrence of a code unit (not counting
+    // the last one of the pattern) to the end of the pattern
+    m_forwardShift.fill(length);
+    for (qsizetype i = 0; i < length - 1; ++i) {
+        m_forwardShift[p[i] & 0xff] = length - 1 - i;
+    }
+
+    // backward: distance from the start of the pattern to the first occurrence
+    // of a code unit (not counting the first one of the pattern)
+    m_backwardShift.fill(length);
+    for (qsizetype i = length - 1; i > 0; --i) {
+        m_backwardShift[p[i] & 0xff] = i;
+    }
+
+    if (length == 0) {
+        return;
+    }
+    if (m_cs == Qt::CaseSensitive) {
+        m_firstVariants.fill(p[0]);
+        m_lastVariants.fill(p[length - 1]);
+        m_variantCount = 1;
+        return;
+    }
+
+    // Case insensitive: the filter needs to know every code unit which folds
+    // to the first and last code units of the pattern; that's only practical
+    // when those are ASCII
+    const int firstCount = foldingVariants(p[0], m_firstVariants);
+    const int lastCount = foldingVariants(p[length - 1], m_lastVariants);
+    if (firstCount == 0 || lastCount == 0) {
+        return;
+    }
+    // pad the unused slots, the filter always compares against all of them
+    for (int i = firstCount; i < MaxVariants; ++i) {
+        m_firstVariants[i] = m_firstVariants[0];
+    }
+    for (int i = lastCount; i < MaxVariants; ++i) {
+        m_lastVariants[i] = m_lastVariants[0];
+    }
+    m_variantCount = MaxVariants;
+}
+
+template<bool Fold>
+bool KFindLiteralMatcher::matchesAt(QStringView text, qsizetype index) const
+{
+    const qsizetype length = m_searchPattern.size();
+    const char16_t *p = m_searchPattern.utf16();
+    if (!Fold) {
+        return std::memcmp(text.utf16() + index, p, length * sizeof(char16_t)) == 0;
+    }
+    for (qsizetype i = 0; i < length; ++i) {
+        if (foldedUnitAt(text, index + i) != p[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<bool Fold>
+qsizetype KFindLiteralMatcher::forwardSearch(QStringView text, qsizetype from) const
+{
+    const qsizetype length = m_searchPattern.size();
+    const char16_t *t = text.utf16();
+    const char16_t *p = m_searchPattern.utf16();
+    const qsizetype lastStart = text.size() - length;
+    qsizetype i = from;
+
+    if (length >= HORSPOOL_MIN_LENGTH || m_variantCount == 0) {
+        const char16_t lastUnit = p[length - 1];
+        while (i <= lastStart) {
+            const char16_t unit = Fold ? foldedUnitAt(text, i + length - 1) : t[i + length - 1];
+            if (unit == lastUnit && matchesAt<Fold>(text, i)) {
+                return i;
+            }
+            i += m_forwardShift[unit & 0xff];
+        }
+        return -1;
+    }
+
+#ifdef __SSE2__
+    // Compare the first and the last code unit of the pattern (and, when
+    // folding, every other code unit folding to them) against eight candidate
+    // positions at once, and only look at the rest of the pattern where both
+    // of them match.
+    const __m128i first0 = _mm_set1_epi16(short(m_firstVariants[0]));
+    const __m128i first1 = _mm_set1_epi16(short(m_firstVariants[1]));
+    const __m128i first2 = _mm_set1_epi16(short(m_firstVariants[2]));
+    const __m128i last0 = _mm_set1_epi16(short(m_lastVariants[0]));
+    const __m128i last1 = _mm_set1_epi16(short(m_lastVariants[1]));
+    const __m128i last2 = _mm_set1_epi16(short(m_lastVariants[2]));
+    for (; i + 7 <= lastStart; i += 8) {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(t + i));
+        const __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(t + i + length - 1));
+        __m128i firstMatches = _mm_cmpeq_epi16(first, first0);
+        __m128i lastMatches = _mm_cmpeq_epi16(last, last0);
+        if (Fold) {
+            firstMatches = _mm_or_si128(firstMatches, _mm_or_si128(_mm_cmpeq_epi16(first, first1), _mm_cmpeq_epi16(first, first2)));
+            lastMatches = _mm_or_si128(lastMatches, _mm_or_si128(_mm_cmpeq_epi16(last, last1), _mm_cmpeq_epi16(last, last2)));
+        }
+        uint mask = uint(_mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches)));
+        while (mask) {
+            const uint bit = qCountTrailingZeroBits(mask);
+            const qsizetype candidate = i + bit / 2;
+            if (matchesAt<Fold>(text, candidate)) {
+                return candidate;
+            }
+            mask &= ~(3u << bit);
+        }
+    }
+#endif
+
+    for (; i <= lastStart; ++i) {
+        if (matchesAt<Fold>(text, i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+template<bool Fold>
+qsizetype KFindLiteralMatcher::backwardSearch(QStringView text, qsizetype from) const
+{
+    const qsizetype length = m_searchPattern.size();
+    const char16_t *t = text.utf16();
+    const char16_t *p = m_searchPattern.utf16();
+    qsizetype i = from;
+
+    if (length >= HORSPOOL_MIN_LENGTH || m_variantCount == 0) {
+        const char16_t firstUnit = p[0];
+        while (i >= 0) {
+            const char16_t unit = Fold ? foldedUnitAt(text, i) : t[i];
+            if (unit == firstUnit && matchesAt<Fold>(text, i)) {
+                return i;
+            }
+            i -= m_backwardShift[unit & 0xff];
+        }
+        return -1;
+    }
+
+#ifdef __SSE2__
+    const __m128i first0 = _mm_set1_epi16(short(m_firstVariants[0]));
+    const __m128i first1 = _mm_set1_epi16(short(m_firstVariants[1]));
+    const __m128i first2 = _mm_set1_epi16(short(m_firstVariants[2]));
+    const __m128i last0 = _mm_set1_epi16(short(m_lastVariants[0]));
+    const __m128i last1 = _mm_set1_epi16(short(m_lastVariants[1]));
+    const __m128i last2 = _mm_set1_epi16(short(m_lastVariants[2]));
+    for (; i - 7 >= 0; i -= 8) {
+        const qsizetype block = i - 7;
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(t + block));
+        const __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(t + block + length - 1));
+        __m128i firstMatches = _mm_cmpeq_epi16(first, first0);
+        __m128i lastMatches = _mm_cmpeq_epi16(last, last0);
+        if (Fold) {
+            firstMatches = _mm_or_si128(firstMatches, _mm_or_si128(_mm_cmpeq_epi16(first, first1), _mm_cmpeq_epi16(first, first2)));
+            lastMatches = _mm_or_si128(lastMatches, _mm_or_si128(_mm_cmpeq_epi16(last, last1), _mm_cmpeq_epi16(last, last2)));
+        }
+        uint mask = uint(_mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches)));
+        while (mask) {
+            const uint bit = 31 - qCountLeadingZeroBits(mask);
+            const qsizetype candidate = block + bit / 2;
+            if (matchesAt<Fold>(text, candidate)) {
+                return candidate;
+            }
+            mask &= ~(3u << (bit - 1));
+        }
+    }
+#endif
+
+    for (; i >= 0; --i) {
+        if (matchesAt<Fold>(text, i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+qsizetype KFindLiteralMatcher::indexIn(QStringView text, qsizetype from) const
+{
+    if (from < 0 || from > text.size()) {
+        return -1;
+    }
+    if (m_searchPattern.isEmpty()) {
+        return from;
+    }
+    return m_cs == Qt::CaseSensitive ? forwardSearch<false>(text, from) : forwardSearch<true>(text, from);
+}
+
+qsizetype KFindLiteralMatcher::lastIndexIn(QStringView text, qsizetype from) const
+{
+    if (from < 0) {
+        return -1;
+    }
+    from = qMin(from, text.size() - m_searchPattern.size());
+    if (from < 0) {
+        return -1;
+    }
+    if (m_searchPattern.isEmpty()) {
+        return from;
+    }
+    return m_cs == Qt::CaseSensitive ? backwardSearch<false>(text, from) : backwardSearch<true>(text, from);
+}
+
+bool KFindLiteralMatcher::matchesAt(QStringView text, qsizetype index) const
+{
+    if (index < 0 || index > text.size() - m_searchPattern.size()) {
+        return false;
+    }
+    return m_cs == Qt::CaseSensitive ? matchesAt<false>(text, index) : matchesAt<true>(text, index);
+}
+
+qsizetype KFindLiteralMatcher::wholeWordIndexIn(QStringView text, qsizetype from) const
+{
+    const qsizetype length = m_searchPattern.size();
+    qsizetype index = from;
+    while ((index = indexIn(text, index)) != -1) {
+        const qsizetype end = index + length;
+        if ((index == 0 || !isInWord(text[index - 1])) && (end == text.size() || !isInWord(text[end]))) {
+            return index;
+        }
+        // Whatever made this occurrence fail, the next one has to start right
+        // after a non-word character, so skip the rest of the current word
+        // instead of trying every position inside it.
+        while (index < text.size() && isInWord(text[index])) {
+            ++index;
+        }
+        ++index;
+    }
+    return -1;
+}
+
+qsizetype KFindLiteralMatcher::wholeWordLastIndexIn(QStringView text, qsizetype from) const
+{
+    const qsizetype length = m_searchPattern.size();
+    qsizetype index = from;
+    while ((index = lastIndexIn(text, index)) != -1) {
+        const qsizetype end = index + length;
+        if ((index == 0 || !isInWord(text[index - 1])) && (end == text.size() || !isInWord(text[end]))) {
+            return index;
+        }
+        // The previous occurrence has to end right before a non-word character
+        // (it can't reach the end of the text any more), so skip back over the
+        // word that the current one ends in.
+        qsizetype boundary = end - 1;
+        while (boundary >= 0 && isInWord(text[boundary])) {
+            --boundary;
+        }
+        if (boundary < 0) {
+            break;
+        }
+        index = boundary - length;
+    }
+    return -1;
+}
+
+static QString foldedText(const QString &text)
+{
+    QString folded(text.size(), Qt::Uninitialized);
+    char16_t *units = reinterpret_cast<char16_t *>(folded.data());
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        units[i] = foldedUnitAt(text, i);
+    }
+    return folded;
+}
+
+static bool isWholeWordAt(QStringView text, qsizetype index, qsizetype length)
+{
+    const qsizetype end = index + length;
+    return (index == 0 || !isInWord(text[index - 1])) && (end == text.size() || !isInWord(text[end]));
+}
+
+void KFindMultiMatcher::Automaton::build(const QList<QString> &keys)
+{
+    nodes.clear();
+    edges.clear();
+    nodes.append(Node());
+
+    // Build the trie, with its edges keyed on the node and the code unit
+    QHash<quint64, int> children;
+    for (int i = 0; i < keys.size(); ++i) {
+        const QString &key = keys.at(i);
+        if (key.isEmpty()) {
+            continue;
+        }
+        int state = 0;
+        for (const QChar ch : key) {
+            const quint64 edgeKey = (quint64(state) << 16) | ch.unicode();
+            auto it = children.constFind(edgeKey);
+            if (it == children.constEnd()) {
+                Node node;
+                node.depth = nodes.at(state).depth + 1;
+                nodes.append(node);
+                it = children.insert(edgeKey, nodes.size() - 1);
+            }
+            state = it.value();
+        }
+        // of duplicate patterns, the first one is reported
+        if (nodes.at(state).pattern == -1) {
+            nodes[state].pattern = i;
+        }
+    }
+
+    // Lay out the edges of each node next to each other, sorted by code unit
+    // so that next() can binary search them
+    QList<quint64> edgeKeys = children.keys();
+    std::sort(edgeKeys.begin(), edgeKeys.end());
+    edges.reserve(edgeKeys.size());
+    for (const quint64 edgeKey : std::as_const(edgeKeys)) {
+        const int state = int(edgeKey >> 16);
+        Node &node = nodes[state];
+        if (node.edgeCount == 0) {
+            node.firstEdge = edges.size();
+        }
+        ++node.edgeCount;
+        edges.append(Edge{char16_t(edgeKey & 0xffff), children.value(edgeKey)});
+    }
+
+    // Compute the failure links breadth first, as the link of a node is
+    // always shallower than the node itself
+    QList<int> queue;
+    queue.reserve(nodes.size());
+    queue.append(0);
+    for (qsizetype head = 0; head < queue.size(); ++head) {
+        const int state = queue.at(head);
+        const Node node = nodes.at(state);
+        for (int e = node.firstEdge; e < node.firstEdge + node.edgeCount; ++e) {
+            const Edge edge = edges.at(e);
+            Node &child = nodes[edge.target];
+            child.fail = state == 0 ? 0 : next(node.fail, edge.unit);
+            const Node &fail = nodes.at(child.fail);
+            child.dictionary = fail.pattern != -1 ? child.fail : fail.dictionary;
+            queue.append(edge.target);
+        }
+    }
+}
+
+int KFindMultiMatcher::Automaton::next(int state, char16_t unit) const
+{
+    while (true) {
+        const Node &node = nodes.at(state);
+        const Edge *first = edges.constData() + node.firstEdge;
+        const Edge *last = first + node.edgeCount;
+        const Edge *edge = std::lower_bound(first, last, unit, [](const Edge &candidate, char16_t value) {
+            return candidate.unit < value;
+        });
+        if (edge != last && edge->unit == unit) {
+            return edge->target;
+        }
+        if (state == 0) {
+            return 0;
+        }
+        state = node.fail;
+    }
+}
+
+KFindMultiMatcher::KFindMultiMatcher(const QStringList &patterns, Qt::CaseSensitivity cs)
+    : m_patterns(patterns)
+    , m_cs(cs)
+{
+    QList<QString> keys;
+    QList<QString> reversedKeys;
+    keys.reserve(patterns.size());
+    reversedKeys.reserve(patterns.size());
+    for (const QString &pattern : patterns) {
+        // fold the patterns once here, like KFindLiteralMatcher does
+        QString key = m_cs == Qt::CaseInsensitive ? foldedText(pattern) : pattern;
+        m_maxLength = qMax(m_maxLength, key.size());
+        keys.append(key);
+        std::reverse(key.begin(), key.end());
+        reversedKeys.append(key);
+    }
+    m_forward.build(keys);
+    m_backward.build(reversedKeys);
+}
+
+template<bool Fold>
+KFindMultiMatcher::Match KFindMultiMatcher::forwardSearch(QStringView text, qsizetype from, bool wholeWords) const
+{
+    // The automaton reports the occurrences by their end, so after finding
+    // one, keep going as long as an occurrence starting before it (or a
+    // longer one starting at the same index) might still end
+    Match best;
+    qsizetype end = text.size();
+    int state = 0;
+    for (qsizetype i = from; i < end; ++i) {
+        state = m_forward.next(state, Fold ? foldedUnitAt(text, i) : text.utf16()[i]);
+        for (int node = m_forward.output(state); node != -1; node = m_forward.nodes.at(node).dictionary) {
+            const qsizetype length = m_forward.nodes.at(node).depth;
+            const qsizetype start = i + 1 - length;
+            if (best.index != -1 && (start > best.index || (start == best.index && length <= best.length))) {
+                continue;
+            }
+            if (wholeWords && !isWholeWordAt(text, start, length)) {
+                continue;
+            }
+            best = Match{start, length, m_forward.nodes.at(node).pattern};
+            end = qMin(text.size(), start + m_maxLength);
+        }
+    }
+    return best;
+}
+
+template<bool Fold>
+KFindMultiMatcher::Match KFindMultiMatcher::backwardSearch(QStringView text, qsizetype from, bool wholeWords) const
+{
+    // The backward automaton reports the occurrences by their start, going
+    // back from the furthest end of one starting at @p from; the first
+    // one found at or before @p from is the last one, and the occurrences
+    // of a state come longest first
+    int state = 0;
+    for (qsizetype i = qMin(text.size(), from + m_maxLength) - 1; i >= 0; --i) {
+        state = m_backward.next(state, Fold ? foldedUnitAt(text, i) : text.utf16()[i]);
+        if (i > from) {
+            continue;
+        }
+        for (int node = m_backward.output(state); node != -1; node = m_backward.nodes.at(node).dictionary) {
+            const qsizetype length = m_backward.nodes.at(node).depth;
+            if (!wholeWords || isWholeWordAt(text, i, length)) {
+                return Match{i, length, m_backward.nodes.at(node).pattern};
+            }
+        }
+    }
+    return Match();
+}
+
+KFindMultiMatcher::Match KFindMultiMatcher::indexIn(QStringView text, qsizetype from, bool wholeWords) const
+{
+    if (from < 0 || from > text.size() || m_maxLength == 0) {
+        return Match();
+    }
+    return m_cs == Qt::CaseSensitive ? forwardSearch<false>(text, from, wholeWords) : forwardSearch<true>(text, from, wholeWords);
+}
+
+KFindMultiMatcher::Match KFindMultiMatcher::lastIndexIn(QStringView text, qsizetype from, bool wholeWords) const
+{
+    if (from < 0 || m_maxLength == 0) {
+        return Match();
+    }
+    from = qMin(from, text.size() - 1);
+    return m_cs == Qt::CaseSensitive ? backwardSearch<false>(text, from, wholeWords) : backwardSearch<true>(text, from, wholeWords);
+}
+
+void KFindApproximateMatcher::PatternMasks::build(QStringView pattern)
+{
+    blocks = int((pattern.size() + 63) / 64);
+    lastBit = quint64(1) << ((pattern.size() - 1) % 64);
+    asciiRows.fill(-1);
+    otherRows.clear();
+    rows.clear();
+    for (qsizetype i = 0; i < pattern.size(); ++i) {
+        const char16_t unit = pattern.utf16()[i];
+        int row = unit < 0x80 ? asciiRows[unit] : otherRows.value(unit, -1);
+        if (row == -1) {
+            row = int(rows.size() / blocks);
+            rows.resize(rows.size() + blocks);
+            if (unit < 0x80) {
+                asciiRows[unit] = row;
+            } else {
+                otherRows.insert(unit, row);
+            }
+        }
+        rows[row * blocks + i / 64] |= quint64(1) << (i % 64);
+    }
+}
+
+// A column of the matrix of the edit distances between the prefixes of the
+// pattern and the text scanned so far, stored as the differences between
+// consecutive rows, 64 rows per block; see G. Myers, "A fast bit-vector
+// algorithm for approximate string matching based on dynamic programming"
+// (1999), and H. Hyyrö's extension of it to several blocks.
+class KFindApproximateMatcher::Column
+{
+public:
+    // An anchored column gives the distance between the pattern and all the
+    // text scanned, otherwise to the suffix of it which matches best
+    Column(const PatternMasks &masks, qsizetype patternLength, bool anchored)
+        : m_masks(masks)
+        , m_anchored(anchored)
+        , m_score(int(patternLength))
+    {
+        m_positive.resize(masks.blocks);
+        m_negative.resize(masks.blocks);
+        std::fill(m_positive.begin(), m_positive.end(), ~quint64(0));
+        std::fill(m_negative.begin(), m_negative.end(), quint64(0));
+    }
+
+    // the distance for the whole pattern
+    int score() const
+    {
+        return m_score;
+    }
+
+    void advance(char16_t unit)
+    {
+        const quint64 *masks = m_masks.masks(unit);
+        // the horizontal difference entering the top of the current block
+        int carry = m_anchored ? 1 : 0;
+        for (int block = 0; block < m_masks.blocks; ++block) {
+            const quint64 carryNegative = carry < 0 ? 1 : 0;
+            quint64 eq = masks ? masks[block] : 0;
+            const quint64 pv = m_positive[block];
+            const quint64 mv = m_negative[block];
+            const quint64 xv = eq | mv;
+            eq |= carryNegative;
+            const quint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+            quint64 ph = mv | ~(xh | pv);
+            quint64 mh = pv & xh;
+            if (block == m_masks.blocks - 1) {
+                if (ph & m_masks.lastBit) {
+                    ++m_score;
+                } else if (mh & m_masks.lastBit) {
+                    --m_score;
+                }
+            }
+            const int carryOut = (ph >> 63) ? 1 : (mh >> 63) ? -1 : 0;
+            ph = (ph << 1) | (carry > 0 ? 1 : 0);
+            mh = (mh << 1) | carryNegative;
+            m_positive[block] = mh | ~(xv | ph);
+            m_negative[block] = ph & xv;
+            carry = carryOut;
+        }
+    }
+
+private:
+    const PatternMasks &m_masks;
+    QVarLengthArray<quint64, 8> m_positive;
+    QVarLengthArray<quint64, 8> m_negative;
+    bool m_anchored;
+    int m_score;
+};
+
+KFindApproximateMatcher::KFindApproximateMatcher(const QString &pattern, Qt::CaseSensitivity cs, int maxDistance)
+    : m_pattern(pattern)
+    , m_cs(cs)
+    , m_maxDistance(qBound(0, maxDistance, qMax(0, int(pattern.size()) - 1)))
+{
+    if (pattern.isEmpty()) {
+        return;
+    }
+    QString searchPattern = m_cs == Qt::CaseInsensitive ? foldedText(pattern) : pattern;
+    m_forward.build(searchPattern);
+    std::reverse(searchPattern.begin(), searchPattern.end());
+    m_backward.build(searchPattern);
+}
+
+template<bool Fold>
+KFindApproximateMatcher::Match KFindApproximateMatcher::forwardSearch(QStringView text, qsizetype from, bool wholeWords) const
+{
+    const qsizetype length = m_pattern.size();
+    const auto unitAt = [text](qsizetype index) {
+        return Fold ? foldedUnitAt(text, index) : text.utf16()[index];
+    };
+
+    // Look for the ends of the occurrences, then for the start of each by
+    // matching the reversed pattern back from its end. Once one is found,
+    // keep looking for a closer one as long as it would overlap it, or for
+    // a longer one as close. Of spans as close, the longest is preferred,
+    // e.g. "Smith" rather than "mith" for "smith".
+    Match best;
+    Column column(m_forward, length, false);
+    for (qsizetype end = from; end < text.size(); ++end) {
+        column.advance(unitAt(end));
+        if (best.index != -1 && end >= best.index + best.length + m_maxDistance) {
+            break;
+        }
+        if (column.score() > m_maxDistance || (best.index != -1 && column.score() > best.distance)) {
+            continue;
+        }
+        if (wholeWords && end + 1 < text.size() && isInWord(text[end + 1])) {
+            continue;
+        }
+
+        Column reversed(m_backward, length, true);
+        qsizetype start = -1;
+        int distance = m_maxDistance + 1;
+        const qsizetype lowest = qMax(from, end + 1 - length - m_maxDistance);
+        for (qsizetype index = end; index >= lowest; --index) {
+            reversed.advance(unitAt(index));
+            if (reversed.score() <= qMin(distance, m_maxDistance) && (!wholeWords || index == 0 || !isInWord(text[index - 1]))) {
+                start = index;
+                distance = reversed.score();
+            }
+        }
+        if (start != -1 && (best.index == -1 || distance < best.distance || start == best.index)) {
+            best = Match{start, end + 1 - start, distance};
+            if (distance == 0) {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+template<bool Fold>
+KFindApproximateMatcher::Match KFindApproximateMatcher::backwardSearch(QStringView text, qsizetype last, bool wholeWords) const
+{
+    const qsizetype length = m_pattern.size();
+    const auto unitAt = [text](qsizetype index) {
+        return Fold ? foldedUnitAt(text, index) : text.utf16()[index];
+    };
+
+    // The same as forwardSearch(), the other way around
+    Match best;
+    Column column(m_backward, length, false);
+    for (qsizetype start = last; start >= 0; --start) {
+        column.advance(unitAt(start));
+        if (best.index != -1 && start < best.index - m_maxDistance) {
+            break;
+        }
+        if (column.score() > m_maxDistance || (best.index != -1 && column.score() > best.distance)) {
+            continue;
+        }
+        if (wholeWords && start > 0 && isInWord(text[start - 1])) {
+            continue;
+        }
+
+        Column forward(m_forward, length, true);
+        qsizetype end = -1;
+        int distance = m_maxDistance + 1;
+        const qsizetype highest = qMin(last, start + length + m_maxDistance - 1);
+        for (qsizetype index = start; index <= highest; ++index) {
+            forward.advance(unitAt(index));
+            if (forward.score() <= qMin(distance, m_maxDistance) && (!wholeWords || index + 1 == text.size() || !isInWord(text[index + 1]))) {
+                end = index;
+                distance = forward.score();
+            }
+        }
+        if (end != -1 && (best.index == -1 || distance < best.distance || end + 1 == best.index + best.length)) {
+            best = Match{start, end + 1 - start, distance};
+            if (distance == 0) {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+KFindApproximateMatcher::Match KFindApproximateMatcher::indexIn(QStringView text, qsizetype from, bool wholeWords) const
+{
+    if (from < 0 || from > text.size()) {
+        return Match();
+    }
+    if (m_pattern.isEmpty()) {
+        return Match{from, 0, 0};
+    }
+    return m_cs == Qt::CaseSensitive ? forwardSearch<false>(text, from, wholeWords) : forwardSearch<true>(text, from, wholeWords);
+}
+
+KFindApproximateMatcher::Match KFindApproximateMatcher::lastIndexIn(QStringView text, qsizetype last, bool wholeWords) const
+{
+    if (last < 0) {
+        return Match();
+    }
+    if (m_pattern.isEmpty()) {
+        return Match{qMin(last, text.size()), 0, 0};
+    }
+    last = qMin(last, text.size() - 1);
+    return m_cs == Qt::CaseSensitive ? backwardSearch<false>(text, last, wholeWords) : backwardSearch<true>(text, last, wholeWords);
+}
+
+// Appends @p ucs4 to @p out without its non-spacing marks: a character whose
+// canonical decomposition is a base character followed by such marks is
+// replaced by that base character. Other decompositions, e.g. of Hangul
+// syllables into several letters, are kept as they are, so that a match
+// never ends in the middle of an original character.
+static void appendStripped(char32_t ucs4, QString &out)
+{
+    if (ucs4 < 0x80) {
+        out.append(QChar(char16_t(ucs4)));
+        return;
+    }
+    if (QChar::category(ucs4) == QChar::Mark_NonSpacing) {
+        return;
+    }
+    // the base character of a decomposition can be decomposed again
+    while (QChar::decompositionTag(ucs4) == QChar::Canonical) {
+        const QList<uint> decomposition = QChar::decomposition(ucs4).toUcs4();
+        const bool marksOnly = std::all_of(decomposition.cbegin() + 1, decomposition.cend(), [](uint part) {
+            return QChar::category(part) == QChar::Mark_NonSpacing;
+        });
+        if (!marksOnly) {
+            break;
+        }
+        ucs4 = decomposition.first();
+    }
+    if (QChar::requiresSurrogates(ucs4)) {
+        out.append(QChar(QChar::highSurrogate(ucs4)));
+        out.append(QChar(QChar::lowSurrogate(ucs4)));
+    } else {
+        out.append(QChar(char16_t(ucs4)));
+    }
+}
+
+// Calls @p strippedCharacter(originalIndex) after appending the stripped
+// version of each character of @p text to @p out
+template<typename Callback>
+static void stripText(const QString &text, QString &out, Callback strippedCharacter)
+{
+    out.reserve(text.size());
+    const char16_t *units = text.utf16();
+    for (qsizetype i = 0; i < text.size();) {
+        const qsizetype start = i;
+        char32_t ucs4 = units[i++];
+        if (QChar::isHighSurrogate(ucs4) && i < text.size() && QChar::isLowSurrogate(units[i])) {
+            ucs4 = QChar::surrogateToUcs4(char16_t(ucs4), units[i++]);
+        }
+        appendStripped(ucs4, out);
+        strippedCharacter(start);
+    }
+}
+
+QString KFindStrippedText::strip(const QString &text)
+{
+    QString stripped;
+    stripText(text, stripped, [](qsizetype) { });
+    return stripped;
+}
+
+KFindStrippedText::KFindStrippedText(const QString &text)
+    : m_originalLength(int(text.size()))
+{
+    m_runs.append(Run{0, 0});
+    int mapped = 0; // the stripped code units mapped so far
+    stripText(text, m_text, [this, &mapped](qsizetype original) {
+        // all the code units of a stripped character map to its start
+        for (; mapped < m_text.size(); ++mapped) {
+            const int offset = int(original) - mapped;
+            if (offset == m_runs.last().offset) {
+                continue;
+            }
+            if (m_runs.last().index == mapped) {
+                m_runs.last().offset = offset;
+            } else {
+                m_runs.append(Run{mapped, offset});
+            }
+        }
+    });
+}
+
+qsizetype KFindStrippedText::toOriginal(qsizetype index) const
+{
+    if (index >= m_text.size()) {
+        return m_originalLength;
+    }
+    auto run = std::upper_bound(m_runs.cbegin(), m_runs.cend(), index, [](qsizetype value, const Run &candidate) {
+        return value < candidate.index;
+    });
+    return index + (run - 1)->offset;
+}
+
+qsizetype KFindStrippedText::fromOriginal(qsizetype index) const
+{
+    // toOriginal() never decreases, find the first index it maps at or after @p index
+    qsizetype low = 0;
+    qsizetype high = m_text.size();
+    while (low < high) {
+        const qsizetype middle = low + (high - low) / 2;
+        if (toOriginal(middle) < index) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+qsizetype KFindStrippedText::lastFromOriginal(qsizetype index) const
+{
+    qsizetype low = 0;
+    qsizetype high = m_text.size() + 1;
+    while (low < high) {
+        const qsizetype middle = low + (high - low) / 2;
+        if (toOriginal(middle) <= index) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low - 1;
+}
+
+void KFindStrippedText::replace(qsizetype index, qsizetype length, QStringView after)
+{
+    const qsizetype start = fromOriginal(index);
+    const qsizetype end = fromOriginal(index + length);
+    const KFindStrippedText replacement(after.toString());
+    const int strippedDelta = int(replacement.m_text.size() - (end - start));
+    const int originalDelta = int(after.size() - length);
+
+    QList<Run> runs;
+    runs.reserve(m_runs.size() + replacement.m_runs.size());
+    auto appendRun = [&runs](int runIndex, int offset) {
+        if (!runs.isEmpty() && runs.last().offset == offset) {
+            return;
+        }
+        if (!runs.isEmpty() && runs.last().index == runIndex) {
+            runs.last().offset = offset;
+        } else {
+            runs.append(Run{runIndex, offset});
+        }
+    };
+    // the runs before the replaced text don't change, those of the
+    // replacement and after it move by the difference in length
+    for (const Run &run : std::as_const(m_runs)) {
+        if (run.index >= start) {
+            break;
+        }
+        appendRun(run.index, run.offset);
+    }
+    for (const Run &run : std::as_const(replacement.m_runs)) {
+        appendRun(int(start) + run.index, int(index - start) + run.offset);
+    }
+    if (end < m_text.size()) {
+        appendRun(int(end) + strippedDelta, int(toOriginal(end) - end) + originalDelta - strippedDelta);
+        for (const Run &run : std::as_const(m_runs)) {
+            if (run.index > end) {
+                appendRun(run.index + strippedDelta, run.offset + originalDelta - strippedDelta);
+            }
+        }
+    }
+
+    m_text.replace(start, end - start, replacement.m_text);
+    m_runs = runs;
+    m_originalLength += originalDelta;
+}
+
+// Literals shorter than this occur too often for trying a regular
+// expression only where they do to be worth it
+static const qsizetype REGEXP_LITERAL_MIN_LENGTH = 2;
+
+static bool isAsciiAlphanumeric(QChar ch)
+{
+    return ch.unicode() < 0x80 && ch.isLetterOrNumber();
+}
+
+// Skips the braces at @p index of a regular expression pattern, e.g. of a
+// quantifier or of the argument of an escape, or returns -1 if they hold
+// anything which could be more than that
+static qsizetype skipBraces(const QString &pattern, qsizetype index, QChar close)
+{
+    for (qsizetype i = index + 1; i < pattern.size(); ++i) {
+        const QChar ch = pattern.at(i);
+        if (ch == close) {
+            return i + 1;
+        }
+        if (ch == u'|' || ch == u'(' || ch == u')' || ch == u'[' || ch == u'\\') {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+static bool isQuantifierAt(const QString &pattern, qsizetype index)
+{
+    if (index >= pattern.size()) {
+        return false;
+    }
+    const QChar ch = pattern.at(index);
+    return ch == u'*' || ch == u'+' || ch == u'?' || ch == u'{';
+}
+
+// Skips the quantifier at @p index, if any, with its lazy or possessive
+// suffix. A brace which isn't a quantifier is a literal for PCRE, skipping
+// it with the following text up to the closing brace only loses literals.
+static qsizetype skipQuantifier(const QString &pattern, qsizetype index)
+{
+    if (!isQuantifierAt(pattern, index)) {
+        return index;
+    }
+    index = pattern.at(index) == u'{' ? skipBraces(pattern, index, u'}') : index + 1;
+    if (index != -1 && index < pattern.size() && (pattern.at(index) == u'?' || pattern.at(index) == u'+')) {
+        ++index;
+    }
+    return index;
+}
+
+// Skips the escape sequence with a letter or a digit at @p index, with its
+// arguments, or returns -1 if it can't be skipped
+static qsizetype skipEscape(const QString &pattern, qsizetype index)
+{
+    if (index + 1 >= pattern.size()) {
+        return -1;
+    }
+    const QChar escape = pattern.at(index + 1);
+    index += 2;
+    if (!isAsciiAlphanumeric(escape)) {
+        return index;
+    }
+    const QChar next = index < pattern.size() ? pattern.at(index) : QChar();
+    switch (escape.unicode()) {
+    case u'G':
+        // matches where the search started, which trying the regular
+        // expression at other offsets changes
+        return -1;
+    case u'K':
+        // moves the start of the match past the text matched before it,
+        // which then isn't part of the match
+        return -1;
+    case u'Q': {
+        const qsizetype end = pattern.indexOf(QLatin1String("\\E"), index);
+        return end == -1 ? pattern.size() : end + 2;
+    }
+    case u'c':
+        return qMin(index + 1, pattern.size());
+    case u'k':
+    case u'g':
+        if (next == u'<') {
+            return skipBraces(pattern, index, u'>');
+        }
+        if (next == u'\'') {
+            return skipBraces(pattern, index, u'\'');
+        }
+        break;
+    case u'p':
+    case u'P':
+        if (next != u'{') {
+            return qMin(index + 1, pattern.size());
+        }
+        break;
+    case u'x':
+        if (next != u'{') {
+            for (int digits = 0; digits < 2 && index < pattern.size() && QStringView(u"0123456789abcdefABCDEF").contains(pattern.at(index)); ++digits) {
+                ++index;
+            }
+            return index;
+        }
+        break;
+    }
+    if (next == u'{') {
+        return skipBraces(pattern, index, u'}');
+    }
+    // octal escapes and back references
+    while (escape.isDigit() && index < pattern.size() && pattern.at(index).unicode() < 0x80 && pattern.at(index).isDigit()) {
+        ++index;
+    }
+    return index;
+}
+
+// Skips the character class at @p index, or returns -1 if it isn't closed
+static qsizetype skipClass(const QString &pattern, qsizetype index)
+{
+    qsizetype i = index + 1;
+    if (i < pattern.size() && pattern.at(i) == u'^') {
+        ++i;
+    }
+    // a closing bracket first is a literal
+    if (i < pattern.size() && pattern.at(i) == u']') {
+        ++i;
+    }
+    while (i < pattern.size()) {
+        const QChar ch = pattern.at(i);
+        if (ch == u'\\') {
+            if (i + 1 < pattern.size() && pattern.at(i + 1) == u'Q') {
+                const qsizetype end = pattern.indexOf(QLatin1String("\\E"), i + 2);
+                if (end == -1) {
+                    return -1;
+                }
+                i = end + 2;
+            } else {
+                i += 2;
+            }
+            continue;
+        }
+        if (ch == u'[' && i + 1 < pattern.size() && pattern.at(i + 1) == u':') {
+            // a POSIX class, e.g. [:alpha:]
+            const qsizetype end = pattern.indexOf(QLatin1String(":]"), i + 2);
+            if (end != -1) {
+                i = end + 2;
+                continue;
+            }
+        }
+        if (ch == u']') {
+            return i + 1;
+        }
+        ++i;
+    }
+    return -1;
+}
+
+// Whether the group at @p index can be skipped: not a comment, nor a verb
+// like (*UCP), nor inline options which could change the meaning of the
+// rest of the pattern, like (?i) or (?x)
+static bool isSkippableGroup(const QString &pattern, qsizetype index)
+{
+    if (index + 1 >= pattern.size()) {
+        return false;
+    }
+    const QChar kind = pattern.at(index + 1);
+    if (kind == u'*') {
+        return false;
+    }
+    if (kind != u'?') {
+        return true;
+    }
+    if (index + 2 >= pattern.size()) {
+        return false;
+    }
+    const QChar ch = pattern.at(index + 2);
+    return ch == u':' || ch == u'=' || ch == u'!' || ch == u'<' || ch == u'>' || ch == u'|' || ch == u'\'';
+}
+
+// Skips the group at @p index, or returns -1 if it can't be skipped
+static qsizetype skipGroup(const QString &pattern, qsizetype index)
+{
+    int depth = 0;
+    qsizetype i = index;
+    while (i < pattern.size()) {
+        const QChar ch = pattern.at(i);
+        if (ch == u'\\') {
+            i = skipEscape(pattern, i);
+        } else if (ch == u'[') {
+            i = skipClass(pattern, i);
+        } else if (ch == u'(') {
+            if (!isSkippableGroup(pattern, i)) {
+                return -1;
+            }
+            ++depth;
+            ++i;
+        } else if (ch == u')') {
+            ++i;
+            if (--depth == 0) {
+                return i;
+            }
+        } else {
+            ++i;
+        }
+        if (i == -1) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// Finds the literals which all the matches of a regular expression contain,
+// by going through the top level of its pattern: @p prefix is set to the
+// literal that all the matches start with and @p longest to the longest
+// literal that all the matches contain, or to empty strings if there is none
+// or if the pattern has constructs which aren't handled, like alternatives.
+static void findRegExpLiterals(const QString &pattern, QString *prefix, QString *longest)
+{
+    QString run;
+    bool runIsPrefix = false;
+    bool atStart = true; // nothing matching any text came yet
+    const auto endRun = [&]() {
+        if (runIsPrefix) {
+            *prefix = run;
+        }
+        if (run.size() > longest->size()) {
+            *longest = run;
+        }
+        run.clear();
+        runIsPrefix = false;
+    };
+    const auto appendToRun = [&](QChar literal) {
+        if (run.isEmpty()) {
+            runIsPrefix = atStart;
+        }
+        run += literal;
+        atStart = false;
+    };
+
+    qsizetype i = 0;
+    while (i < pattern.size()) {
+        const QChar ch = pattern.at(i);
+        bool isLiteral = false;
+        QChar literal;
+        switch (ch.unicode()) {
+        case u'\\':
+            if (i + 1 < pattern.size() && !isAsciiAlphanumeric(pattern.at(i + 1)) && !pattern.at(i + 1).isSurrogate()) {
+                isLiteral = true;
+                literal = pattern.at(i + 1);
+                i += 2;
+            } else if (i + 1 < pattern.size() && QStringView(u"bBA").contains(pattern.at(i + 1))) {
+                // assertions, which match no text
+                i += 2;
+                if (isQuantifierAt(pattern, i)) {
+                    i = -1;
+                    break;
+                }
+                continue;
+            } else {
+                i = skipEscape(pattern, i);
+            }
+            break;
+        case u'[':
+            i = skipClass(pattern, i);
+            break;
+        case u'(':
+            i = isSkippableGroup(pattern, i) ? skipGroup(pattern, i) : -1;
+            break;
+        case u'^':
+            ++i;
+            if (i == 1) {
+                // the start of a line, before the prefix
+                continue;
+            }
+            break;
+        case u'.':
+        case u'$':
+            ++i;
+            break;
+        case u'|':
+        case u')':
+        case u'*':
+        case u'+':
+        case u'?':
+        case u'{':
+            // alternatives, or a pattern which isn't understood
+            i = -1;
+            break;
+        default:
+            if (ch.isSurrogate()) {
+                i += (ch.isHighSurrogate() && i + 1 < pattern.size() && pattern.at(i + 1).isLowSurrogate()) ? 2 : 1;
+            } else {
+                isLiteral = true;
+                literal = ch;
+                ++i;
+            }
+            break;
+        }
+        if (i == -1) {
+            prefix->clear();
+            longest->clear();
+            return;
+        }
+
+        if (isLiteral && !isQuantifierAt(pattern, i)) {
+            appendToRun(literal);
+            continue;
+        }
+        // a quantifier only applies to the last character, which is still
+        // there at least once with '+'
+        if (isLiteral && pattern.at(i) == u'+') {
+            appendToRun(literal);
+        }
+        endRun();
+        atStart = false;
+        i = skipQuantifier(pattern, i);
+        if (i == -1) {
+            prefix->clear();
+            longest->clear();
+            return;
+        }
+    }
+    endRun();
+}
+
+KFindRegExpPrefilter::KFindRegExpPrefilter(const QString &pattern, Qt::CaseSensitivity cs)
+{
+    QString prefix;
+    QString longest;
+    findRegExpLiterals(pattern, &prefix, &longest);
+    if (prefix.size() >= REGEXP_LITERAL_MIN_LENGTH) {
+        m_prefix = KFindLiteralMatcher(prefix, cs);
+    }
+    // finding the prefix already tells whether there can be a match
+    if (longest.size() >= REGEXP_LITERAL_MIN_LENGTH && longest != prefix) {
+        m_required = KFindLiteralMatcher(longest, cs);
+    }
+}
@@ -0,0 +1,408 @@
+/*
+    This file is part of the KDE project
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#ifndef KFINDMATCHER_P_H
+#define KFINDMATCHER_P_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+
+#include <array>
+
+/**
+ * @internal
+ *
+ * Searches a text for a literal pattern.
+ *
+ * All the per-pattern work (case folding, skip tables, SIMD broadcast
+ * values) is done once in the constructor, so a matcher should be kept
+ * around and reused for as long as the pattern doesn't change. Returned
+ * indexes have the same meaning as those of QStringView::indexOf() and
+ * lastIndexOf(), and are always offsets into the searched text, also for
+ * case insensitive matching.
+ *
+ * A matcher is immutable once constructed, and can be used from several
+ * threads at the same time.
+ */
+class KFindLiteralMatcher
+{
+public:
+    KFindLiteralMatcher() = default;
+    KFindLiteralMatcher(const QString &pattern, Qt::CaseSensitivity cs);
+
+    const QString &pattern() const
+    {
+        return m_pattern;
+    }
+
+    Qt::CaseSensitivity caseSensitivity() const
+    {
+        return m_cs;
+    }
+
+    /**
+     * @return the index of the first occurrence of the pattern in @p text
+     * starting at or after @p from, or -1 if there is none
+     */
+    qsizetype indexIn(QStringView text, qsizetype from) const;
+
+    /**
+     * @return the index of the last occurrence of the pattern in @p text
+     * starting at or before @p from, or -1 if there is none
+     */
+    qsizetype lastIndexIn(QStringView text, qsizetype from) const;
+
+    /**
+     * @return whether the pattern occurs in @p text at @p index
+     */
+    bool matchesAt(QStringView text, qsizetype index) const;
+
+    /**
+     * Same as indexIn(), but only finds occurrences which are whole words,
+     * i.e. which are neither preceded nor followed by a letter, a digit or
+     * an underscore.
+     */
+    qsizetype wholeWordIndexIn(QStringView text, qsizetype from) const;
+
+    /**
+     * Same as lastIndexIn(), but only finds occurrences which are whole words.
+     * @see wholeWordIndexIn()
+     */
+    qsizetype wholeWordLastIndexIn(QStringView text, qsizetype from) const;
+
+private:
+    template<bool Fold>
+    qsizetype forwardSearch(QStringView text, qsizetype from) const;
+    template<bool Fold>
+    qsizetype backwardSearch(QStringView text, qsizetype from) const;
+    template<bool Fold>
+    bool matchesAt(QStringView text, qsizetype index) const;
+
+    QString m_pattern;
+    // the pattern as it is compared to the text, i.e. case folded when
+    // searching case insensitively
+    QString m_searchPattern;
+    Qt::CaseSensitivity m_cs = Qt::CaseSensitive;
+
+    // Horspool shift tables, indexed by the low byte of a (folded) UTF-16
+    // code unit. Code units sharing a low byte share the smallest of their
+    // shifts, which only makes the skips more conservative.
+    std::array<qsizetype, 256> m_forwardShift;
+    std::array<qsizetype, 256> m_backwardShift;
+
+    // All the code units that the first and last code unit of the pattern
+    // match (just one unless searching case insensitively), for the SIMD
+    // candidate filter; zero when the filter can't be used
+    static constexpr int MaxVariants = 3;
+    std::array<char16_t, MaxVariants> m_firstVariants = {};
+    std::array<char16_t, MaxVariants> m_lastVariants = {};
+    int m_variantCount = 0;
+};
+
+/**
+ * @internal
+ *
+ * Searches a text for several literal patterns at once, in a single pass
+ * whatever their number, with an Aho-Corasick automaton.
+ *
+ * Like KFindLiteralMatcher, a matcher does all the per-pattern work in its
+ * constructor, is immutable once constructed and can be used from several
+ * threads at the same time. Empty patterns are never found.
+ */
+class KFindMultiMatcher
+{
+public:
+    struct Match {
+        qsizetype index = -1; // -1 if there is no match
+        qsizetype length = 0;
+        int pattern = -1; // the index of the pattern found
+    };
+
+    KFindMultiMatcher() = default;
+    KFindMultiMatcher(const QStringList &patterns, Qt::CaseSensitivity cs);
+
+    const QStringList &patterns() const
+    {
+        return m_patterns;
+    }
+
+    Qt::CaseSensitivity caseSensitivity() const
+    {
+        return m_cs;
+    }
+
+    /**
+     * @return the first occurrence of any of the patterns in @p text starting
+     * at or after @p from; the longest one if several start there. With
+     * @p wholeWords, only the occurrences which are whole words are found,
+     * as for KFindLiteralMatcher::wholeWordIndexIn().
+     */
+    Match indexIn(QStringView text, qsizetype from, bool wholeWords) const;
+
+    /**
+     * @return the last occurrence of any of the patterns in @p text starting
+     * at or before @p from; the longest one if several start there
+     */
+    Match lastIndexIn(QStringView text, qsizetype from, bool wholeWords) const;
+
+private:
+    // A trie of the (folded) patterns, with the failure links which make it
+    // an Aho-Corasick automaton
+    struct Automaton {
+        struct Node {
+            int fail = 0; // the node of the longest proper suffix in the trie
+            int dictionary = -1; // the node of the longest proper suffix which is a pattern
+            int pattern = -1; // the pattern ending at this node
+            int depth = 0;
+            int firstEdge = 0;
+            int edgeCount = 0;
+        };
+        struct Edge {
+            char16_t unit;
+            int target;
+        };
+
+        void build(const QList<QString> &keys);
+        int next(int state, char16_t unit) const;
+        // the deepest node ending a pattern among @p state and its suffixes, or -1
+        int output(int state) const
+        {
+            return nodes.at(state).pattern != -1 ? state : nodes.at(state).dictionary;
+        }
+
+        QList<Node> nodes;
+        QList<Edge> edges; // sorted by unit for each node
+    };
+
+    template<bool Fold>
+    Match forwardSearch(QStringView text, qsizetype from, bool wholeWords) const;
+    template<bool Fold>
+    Match backwardSearch(QStringView text, qsizetype from, bool wholeWords) const;
+
+    QStringList m_patterns;
+    Qt::CaseSensitivity m_cs = Qt::CaseSensitive;
+    qsizetype m_maxLength = 0;
+    // the forward automaton finds the patterns, the backward one their reverse
+    Automaton m_forward;
+    Automaton m_backward;
+};
+
+/**
+ * @internal
+ *
+ * Searches a text for the approximate occurrences of a pattern, i.e. for the
+ * text which can be turned into the pattern with at most a given number of
+ * insertions, deletions or substitutions of characters (code units).
+ *
+ * The edit distance is computed with Myers' bit-parallel algorithm, 64 rows
+ * of the distance matrix at once, so the text is scanned in
+ * O(n * ceil(m / 64)) for a pattern of length m. Of overlapping approximate
+ * occurrences, the one with the smallest distance is found.
+ *
+ * Like KFindLiteralMatcher, a matcher is immutable once constructed and can
+ * be used from several threads at the same time.
+ */
+class KFindApproximateMatcher
+{
+public:
+    struct Match {
+        qsizetype index = -1; // -1 if there is no match
+        qsizetype length = 0;
+        int distance = -1;
+    };
+
+    KFindApproximateMatcher() = default;
+    /**
+     * @p maxDistance is limited to less than the length of @p pattern, so
+     * that some of the pattern is always found
+     */
+    KFindApproximateMatcher(const QString &pattern, Qt::CaseSensitivity cs, int maxDistance);
+
+    const QString &pattern() const
+    {
+        return m_pattern;
+    }
+
+    Qt::CaseSensitivity caseSensitivity() const
+    {
+        return m_cs;
+    }
+
+    int maxDistance() const
+    {
+        return m_maxDistance;
+    }
+
+    /**
+     * @return the first approximate occurrence of the pattern in @p text
+     * starting at or after @p from. With @p wholeWords, only the occurrences
+     * which are whole words are found.
+     */
+    Match indexIn(QStringView text, qsizetype from, bool wholeWords) const;
+
+    /**
+     * @return the last approximate occurrence of the pattern in @p text
+     * ending at or before @p last, i.e. which doesn't go past the code unit
+     * at @p last
+     */
+    Match lastIndexIn(QStringView text, qsizetype last, bool wholeWords) const;
+
+private:
+    // The bit masks of the positions of each code unit in a pattern, in
+    // blocks of 64 bits
+    struct PatternMasks {
+        void build(QStringView pattern);
+        // the masks of @p unit, or nullptr if it isn't in the pattern
+        const quint64 *masks(char16_t unit) const
+        {
+            const int row = unit < 0x80 ? asciiRows[unit] : otherRows.value(unit, -1);
+            return row == -1 ? nullptr : rows.constData() + row * blocks;
+        }
+
+        int blocks = 0;
+        quint64 lastBit = 0; // the bit of the last row of the pattern, in the last block
+        std::array<int, 0x80> asciiRows;
+        QHash<char16_t, int> otherRows;
+        QList<quint64> rows;
+    };
+
+    class Column;
+
+    template<bool Fold>
+    Match forwardSearch(QStringView text, qsizetype from, bool wholeWords) const;
+    template<bool Fold>
+    Match backwardSearch(QStringView text, qsizetype last, bool wholeWords) const;
+
+    QString m_pattern;
+    Qt::CaseSensitivity m_cs = Qt::CaseSensitive;
+    int m_maxDistance = 0;
+    // the masks of the (folded) pattern, and of the reversed one
+    PatternMasks m_forward;
+    PatternMasks m_backward;
+};
+
+/**
+ * @internal
+ *
+ * A text without its diacritics, for searching regardless of them: the
+ * non-spacing marks are dropped, and a character canonically equivalent to
+ * a base character followed by such marks (as for the NFD normalization
+ * form) is replaced by that base character, so that e.g. "r\u00e9sum\u00e9" and
+ * "re\u0301sume\u0301" both become "resume". Characters decomposing into
+ * several base characters, like Hangul syllables, are kept whole.
+ *
+ * The indexes of the stripped text are mapped back to those of the original
+ * one with a list of the runs over which their difference doesn't change,
+ * which is short for texts with few decomposed characters.
+ */
+class KFindStrippedText
+{
+public:
+    KFindStrippedText() = default;
+    explicit KFindStrippedText(const QString &text);
+
+    /**
+     * @return @p text without its diacritics, e.g. for a pattern
+     */
+    static QString strip(const QString &text);
+
+    const QString &text() const
+    {
+        return m_text;
+    }
+
+    /**
+     * @return the index in the original text of the character which became
+     * the code unit at @p index of the stripped text, or the length of the
+     * original text for the end of the stripped one. The end of a match thus
+     * includes the marks following its last character.
+     */
+    qsizetype toOriginal(qsizetype index) const;
+
+    /**
+     * @return the first index of the stripped text which comes from the
+     * original text at or after @p index
+     */
+    qsizetype fromOriginal(qsizetype index) const;
+
+    /**
+     * @return the last index of the stripped text which comes from the
+     * original text at or before @p index, or -1 if there is none
+     */
+    qsizetype lastFromOriginal(qsizetype index) const;
+
+    /**
+     * Updates the stripped text after the @p length characters at @p index of
+     * the original text were replaced by @p after, only stripping @p after.
+     * @p index and @p length must not split a surrogate pair.
+     */
+    void replace(qsizetype index, qsizetype length, QStringView after);
+
+private:
+    // From the code unit at index of the stripped text on, the original
+    // index is index + offset
+    struct Run {
+        int index;
+        int offset;
+    };
+
+    QString m_text;
+    QList<Run> m_runs;
+    int m_originalLength = 0;
+};
+
+/**
+ * @internal
+ *
+ * The literals which every match of a regular expression contains, found by
+ * looking at the pattern once when it is compiled, for skipping the text
+ * where the regular expression can't match: the literal all the matches start
+ * with (e.g. "ERROR" for "ERROR\s+\d+"), if any, only needs the regular
+ * expression to be tried where it occurs, and a text without the longest
+ * literal all the matches contain can't have a match at all.
+ *
+ * Patterns which the analysis doesn't understand (alternatives at the top
+ * level, inline options...) just have no literals. Like KFindLiteralMatcher,
+ * a prefilter is immutable once constructed and can be used from several
+ * threads at the same time.
+ */
+class KFindRegExpPrefilter
+{
+public:
+    KFindRegExpPrefilter() = default;
+    /**
+     * @p cs must be the case sensitivity of the regular expression
+     */
+    KFindRegExpPrefilter(const QString &pattern, Qt::CaseSensitivity cs);
+
+    /**
+     * @return the matcher of the literal which all the matches start with;
+     * its pattern is empty if there is none
+     */
+    const KFindLiteralMatcher &prefix() const
+    {
+        return m_prefix;
+    }
+
+    /**
+     * @return the matcher of a literal which all the matches contain, other
+     * than the prefix; its pattern is empty if there is none
+     */
+    const KFindLiteralMatcher &required() const
+    {
+        return m_required;
+    }
+
+private:
+    KFindLiteralMatcher m_prefix;
+    KFindLiteralMatcher m_required;
+};
+
+#endif // KFINDMATCHER_P_H
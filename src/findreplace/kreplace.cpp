@@ -13,13 +13,20 @@
 
 #include <QDialogButtonBox>
 #include <QLabel>
+#include <QMetaMethod>
+#include <QPromise>
 #include <QPushButton>
 #include <QRegularExpression>
+#include <QStringEncoder>
+#include <QThreadPool>
 #include <QVBoxLayout>
 
 #include <KLocalizedString>
 #include <KMessageBox>
 
+#include <algorithm>
+#include <memory>
+
 //#define DEBUG_REPLACE
 #define INDEX_NOMATCH -1
 
@@ -93,6 +100,257 @@ QPushButton *KReplaceNextDialog::replaceButton() const
 
 ////
 
+/**
+ * The replacement string of a KReplace, split once into its literal parts and
+ * the backreferences in between, so that each match only needs to be expanded.
+ *
+ * Backreferences are only recognized with KReplaceDialog::BackReference.
+ * With a regular expression, \\N refers to capture group N, taking as many
+ * digits as still make up an existing group, so \\10 is group 10 if there
+ * is one, and group 1 followed by a 0 otherwise. \\g{name} and ${name}
+ * refer to a named group, or to a numbered one with a number between the
+ * braces. \\U and \\L convert everything that follows, literal text as well
+ * as captured text, to upper or lower case, until the next \\E (or \\U or \\L).
+ *
+ * Without a regular expression only \\0, the matched text, is recognized, as
+ * it always was; the rest of the replacement is literal text.
+ */
+class KReplacementTemplate
+{
+public:
+    KReplacementTemplate() = default;
+    KReplacementTemplate(const QString &replacement, long options, const QRegularExpression *regExp);
+
+    bool isCompiledFor(const QString &replacement, long options, const QRegularExpression *regExp) const;
+
+    /**
+     * @return the length of the expansion for a match of @p length characters,
+     * which can be off when converting the case of captured text changes its
+     * length, or when the match was found without diacritics
+     */
+    qsizetype expandedLength(int length, const QRegularExpressionMatch *match) const;
+    /**
+     * Appends the expansion for the match of @p length characters at @p index
+     * in @p text to @p out. @p match is only used for regular expressions;
+     * when it was found in @p stripped, @p text without its diacritics, the
+     * captured text is taken from @p text.
+     */
+    void expandInto(QString &out,
+                    QStringView text,
+                    int index,
+                    int length,
+                    const QRegularExpressionMatch *match,
+                    const KFindStrippedText *stripped = nullptr) const;
+    QString expand(QStringView text, int index, int length, const QRegularExpressionMatch *match, const KFindStrippedText *stripped = nullptr) const;
+
+private:
+    QStringView captured(int capture, QStringView text, int index, int length, const QRegularExpressionMatch *match, const KFindStrippedText *stripped) const
+    {
+        if (!m_isRegExp) {
+            return text.mid(index, length);
+        }
+        if (!stripped) {
+            return match->capturedView(capture);
+        }
+        if (match->capturedStart(capture) < 0) {
+            return QStringView();
+        }
+        // map the capture back to the original text, like the match itself
+        const qsizetype start = stripped->toOriginal(match->capturedStart(capture));
+        return text.mid(start, stripped->toOriginal(match->capturedEnd(capture)) - start);
+    }
+
+    enum CaseConversion {
+        NoConversion,
+        UpperCase,
+        LowerCase,
+    };
+
+    struct Segment {
+        QString text; // used when capture is -1, already case converted
+        int capture = -1;
+        CaseConversion conversion = NoConversion;
+    };
+
+    int captureIndex(QStringView reference, int captureCount, const QStringList &names) const;
+    QList<Segment> m_segments;
+
+    QString m_replacement;
+    long m_options = 0;
+    // the regular expression the template was compiled for, if any
+    bool m_isRegExp = false;
+    QString m_regExpPattern;
+    QRegularExpression::PatternOptions m_regExpOptions;
+};
+
+static constexpr long REPLACEMENT_TEMPLATE_OPTIONS = KReplaceDialog::BackReference | KFind::RegularExpression;
+
+static bool isAsciiDigit(QChar c)
+{
+    return c >= QLatin1Char('0') && c <= QLatin1Char('9');
+}
+
+KReplacementTemplate::KReplacementTemplate(const QString &replacement, long options, const QRegularExpression *regExp)
+    : m_replacement(replacement)
+    , m_options(options & REPLACEMENT_TEMPLATE_OPTIONS)
+{
+    if (regExp && (options & KFind::RegularExpression)) {
+        m_isRegExp = true;
+        m_regExpPattern = regExp->pattern();
+        m_regExpOptions = regExp->patternOptions();
+    }
+
+    if (!(options & KReplaceDialog::BackReference)) {
+        m_segments.append({replacement, -1, NoConversion});
+        return;
+    }
+
+    const int captureCount = m_isRegExp ? regExp->captureCount() : 0;
+    const QStringList names = m_isRegExp ? regExp->namedCaptureGroups() : QStringList();
+    const int length = replacement.length();
+    CaseConversion conversion = NoConversion;
+    QString literal;
+    auto flushLiteral = [&]() {
+        if (!literal.isEmpty()) {
+            switch (conversion) {
+            case NoConversion:
+                break;
+            case UpperCase:
+                literal = literal.toUpper();
+                break;
+            case LowerCase:
+                literal = literal.toLower();
+                break;
+            }
+            m_segments.append({literal, -1, NoConversion});
+            literal.clear();
+        }
+    };
+
+    int i = 0;
+    while (i < length) {
+        const QChar c = replacement.at(i);
+        const QChar next = i + 1 < length ? replacement.at(i + 1) : QChar();
+        if (c == QLatin1Char('\\') && isAsciiDigit(next)) {
+            int capture = next.unicode() - '0';
+            if (capture <= captureCount) {
+                int end = i + 2;
+                // take more digits as long as they still refer to an existing group
+                while (capture != 0 && end < length && isAsciiDigit(replacement.at(end))) {
+                    const int nextCapture = capture * 10 + replacement.at(end).unicode() - '0';
+                    if (nextCapture > captureCount) {
+                        break;
+                    }
+                    capture = nextCapture;
+                    ++end;
+                }
+                flushLiteral();
+                m_segments.append({QString(), capture, conversion});
+                i = end;
+                continue;
+            }
+        } else if (m_isRegExp && ((c == QLatin1Char('\\') && next == QLatin1Char('g')) || (c == QLatin1Char('$') && next == QLatin1Char('{')))) {
+            // \g{name} or ${name}
+            const int open = next == QLatin1Char('{') ? i + 1 : i + 2;
+            const int close = open < length && replacement.at(open) == QLatin1Char('{') ? replacement.indexOf(QLatin1Char('}'), open + 1) : -1;
+            const int capture = close > open ? captureIndex(QStringView(replacement).mid(open + 1, close - open - 1), captureCount, names) : -1;
+            if (capture >= 0) {
+                flushLiteral();
+                m_segments.append({QString(), capture, conversion});
+                i = close + 1;
+                continue;
+            }
+        } else if (m_isRegExp && c == QLatin1Char('\\') && (next == QLatin1Char('U') || next == QLatin1Char('L') || next == QLatin1Char('E'))) {
+            flushLiteral();
+            conversion = next == QLatin1Char('U') ? UpperCase : next == QLatin1Char('L') ? LowerCase : NoConversion;
+            i += 2;
+            continue;
+        }
+        literal += c;
+        ++i;
+    }
+    flushLiteral();
+}
+
+int KReplacementTemplate::captureIndex(QStringView reference, int captureCount, const QStringList &names) const
+{
+    if (reference.isEmpty()) {
+        return -1;
+    }
+    if (std::all_of(reference.begin(), reference.end(), isAsciiDigit)) {
+        bool ok = false;
+        const int capture = reference.toInt(&ok);
+        return ok && capture <= captureCount ? capture : -1;
+    }
+    for (int i = 1; i < names.size(); ++i) {
+        if (names.at(i) == reference) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool KReplacementTemplate::isCompiledFor(const QString &replacement, long options, const QRegularExpression *regExp) const
+{
+    if (m_options != (options & REPLACEMENT_TEMPLATE_OPTIONS) || m_replacement != replacement) {
+        return false;
+    }
+    if (!m_isRegExp) {
+        return !(regExp && (options & KFind::RegularExpression));
+    }
+    return regExp && regExp->pattern() == m_regExpPattern && regExp->patternOptions() == m_regExpOptions;
+}
+
+qsizetype KReplacementTemplate::expandedLength(int length, const QRegularExpressionMatch *match) const
+{
+    qsizetype expandedLength = 0;
+    for (const Segment &segment : m_segments) {
+        if (segment.capture < 0) {
+            expandedLength += segment.text.length();
+        } else {
+            expandedLength += m_isRegExp ? match->capturedLength(segment.capture) : length;
+        }
+    }
+    return expandedLength;
+}
+
+void KReplacementTemplate::expandInto(QString &out,
+                                      QStringView text,
+                                      int index,
+                                      int length,
+                                      const QRegularExpressionMatch *match,
+                                      const KFindStrippedText *stripped) const
+{
+    for (const Segment &segment : m_segments) {
+        if (segment.capture < 0) {
+            out.append(segment.text);
+            continue;
+        }
+        const QStringView capturedText = captured(segment.capture, text, index, length, match, stripped);
+        switch (segment.conversion) {
+        case NoConversion:
+            out.append(capturedText);
+            break;
+        case UpperCase:
+            out.append(capturedText.toString().toUpper());
+            break;
+        case LowerCase:
+            out.append(capturedText.toString().toLower());
+            break;
+        }
+    }
+}
+
+QString KReplacementTemplate::expand(QStringView text, int index, int length, const QRegularExpressionMatch *match, const KFindStrippedText *stripped) const
+{
+    QString rep;
+    rep.reserve(expandedLength(length, match));
+    expandInto(rep, text, index, length, match, stripped);
+    return rep;
+}
+
+////
+
 class KReplacePrivate : public KFindPrivate
 {
     Q_DECLARE_PUBLIC(KReplace)
@@ -105,15 +363,47 @@ public:
     }
 
     KReplaceNextDialog *nextDialog();
+    /**
+     * Returns the replacement template for the current replacement, pattern
+     * and options, parsing the replacement only when one of them changed.
+     */
+    const KReplacementTemplate &replacementTemplate();
     void doReplace();
+    /**
+     * The text without its diacritics in which m_match was found, if the
+     * KFind::IgnoreDiacritics option is set.
+     */
+    const KFindStrippedText *matchedStrippedText();
+    /**
+     * Returns the replacements of all the matches in the text, from the current
+     * index forward, and moves the index past the end of the text.
+     * Stops early when @p promise is canceled, and reports progress to it.
+     */
+    QList<KReplace::Replacement> collectReplacements(QPromise<QList<KReplace::Replacement>> *promise = nullptr);
+    /**
+     * Whether the replacements computed by pendingReplacements() are still
+     * those of the current text, index, pattern and options.
+     */
+    bool hasPendingReplacements() const;
+    void replaceAll();
 
     void slotSkip();
     void slotReplace();
     void slotReplaceAll();
 
     QString m_replacement;
+    KReplacementTemplate m_replacementTemplate;
     int m_replacements = 0;
     QRegularExpressionMatch m_match;
+
+    // cache for pendingReplacements(), reused by the next Replace All
+    QList<KReplace::Replacement> m_pending;
+    QString m_pendingText; // shares its data with the text they were computed for
+    QString m_pendingPattern;
+    QStringList m_pendingPatterns;
+    int m_pendingIndex = INDEX_NOMATCH;
+    long m_pendingOptions = 0;
+    bool m_pendingValid = false;
 };
 
 ////
@@ -181,28 +471,31 @@ void KReplace::displayFinalDialog() const
     }
 }
 
-static int replaceHelper(QString &text, const QString &replacement, int index, long options, const QRegularExpressionMatch *match, int length)
+static int replaceHelper(QString &text,
+                         const KReplacementTemplate &replacement,
+                         int index,
+                         const QRegularExpressionMatch *match,
+                         int length,
+                         const KFindStrippedText *stripped = nullptr)
 {
-    QString rep(replacement);
-    if (options & KReplaceDialog::BackReference) {
-        // Handle backreferences
-        if (options & KFind::RegularExpression) { // regex search
-            Q_ASSERT(match);
-            const int capNum = match->regularExpression().captureCount();
-            for (int i = 0; i <= capNum; ++i) {
-                rep.replace(QLatin1String("\\") + QString::number(i), match->captured(i));
-            }
-        } else { // with non-regex search only \0 is supported, replace it with the
-                 // right portion of 'text'
-            rep.replace(QLatin1String("\\0"), text.mid(index, length));
-        }
-    }
+    const QString rep = replacement.expand(text, index, length, match, stripped);
 
     // Then replace rep into the text
     text.replace(index, length, rep);
     return rep.length();
 }
 
+const KReplacementTemplate &KReplacePrivate::replacementTemplate()
+{
+    // the patterns set by setPatterns() are literal text, they capture nothing
+    const long templateOptions = patterns.isEmpty() ? options : options & ~KFind::RegularExpression;
+    const QRegularExpression *re = templateOptions & KFind::RegularExpression ? &regExp() : nullptr;
+    if (!m_replacementTemplate.isCompiledFor(m_replacement, templateOptions, re)) {
+        m_replacementTemplate = KReplacementTemplate(m_replacement, templateOptions, re);
+    }
+    return m_replacementTemplate;
+}
+
 KFind::Result KReplace::replace()
 {
     Q_D(KReplace);
@@ -215,12 +508,18 @@ KFind::Result KReplace::replace()
         return NoMatch;
     }
 
+    if (!(d->options & KReplaceDialog::PromptOnReplace) && !(d->options & KFind::FindBackwards)) {
+        d->replaceAll();
+        d->lastResult = NoMatch;
+        return NoMatch;
+    }
+
     do { // this loop is only because validateMatch can fail
 #ifdef DEBUG_REPLACE
          // qDebug() << "beginning of loop: d->index=" << d->index;
 #endif
          // Find the next match.
-        d->index = KFind::find(d->text, d->pattern, d->index, d->options, &d->matchedLength, d->options & KFind::RegularExpression ? &d->m_match : nullptr);
+        d->index = d->find(d->text, d->index, &d->matchedLength, d->options & KFind::RegularExpression ? &d->m_match : nullptr);
 
 #ifdef DEBUG_REPLACE
         // qDebug() << "KFind::find returned d->index=" << d->index;
@@ -234,8 +533,7 @@ KFind::Result KReplace::replace()
 #endif
                     // Display accurate initial string and replacement string, they can vary
                     QString matchedText(d->text.mid(d->index, d->matchedLength));
-                    QString rep(matchedText);
-                    replaceHelper(rep, d->m_replacement, 0, d->options, d->options & KFind::RegularExpression ? &d->m_match : nullptr, d->matchedLength);
+                    const QString rep = d->replacementTemplate().expand(d->text, d->index, d->matchedLength, &d->m_match, d->matchedStrippedText());
                     d->nextDialog()->setLabel(matchedText, rep);
                     d->nextDialog()->show(); // TODO kde5: virtual void showReplaceNextDialog(QString,QString), so that kreplacetest can skip the show()
 
@@ -272,7 +570,12 @@ int KReplace::replace(QString &text, const QString &pattern, const QString &repl
     index = KFind::find(text, pattern, index, options, &matchedLength, options & KFind::RegularExpression ? &match : nullptr);
 
     if (index != -1) {
-        *replacedLength = replaceHelper(text, replacement, index, options, options & KFind::RegularExpression ? &match : nullptr, matchedLength);
+        const QRegularExpression re = match.regularExpression();
+        const KReplacementTemplate replacementTemplate(replacement, options, &re);
+        // the regular expression matched the text without its diacritics
+        const bool strippedMatch = (options & KFind::RegularExpression) && (options & KFind::IgnoreDiacritics);
+        const KFindStrippedText stripped = strippedMatch ? KFindStrippedText(text) : KFindStrippedText();
+        *replacedLength = replaceHelper(text, replacementTemplate, index, &match, matchedLength, strippedMatch ? &stripped : nullptr);
         if (options & KFind::FindBackwards) {
             index--;
         } else {
@@ -327,7 +630,22 @@ void KReplacePrivate::doReplace()
     Q_Q(KReplace);
 
     Q_ASSERT(index >= 0);
-    const int replacedLength = replaceHelper(text, m_replacement, index, options, &m_match, matchedLength);
+    const bool ignoreDiacritics = options & KFind::IgnoreDiacritics;
+    if (ignoreDiacritics) {
+        // Update the text without diacritics along with the text, instead of
+        // stripping all of it again for finding the next match. Not keeping
+        // the text in the cache meanwhile avoids a copy when replacing in it.
+        strippedCache = strippedText(text);
+        strippedSource.clear();
+    }
+    // The matches of a backward regular expression search belong to the
+    // text before the replacement, and would keep it from being modified in place
+    regExpMatches = RegExpMatches();
+    const int replacedLength = replaceHelper(text, replacementTemplate(), index, &m_match, matchedLength, ignoreDiacritics ? &strippedCache : nullptr);
+    if (ignoreDiacritics) {
+        strippedCache.replace(index, matchedLength, QStringView(text).mid(index, replacedLength));
+        strippedSource = text;
+    }
 
     // Tell the world about the replacement we made, in case someone wants to
     // highlight it.
@@ -343,7 +661,7 @@ void KReplacePrivate::doReplace()
     } else {
         index += replacedLength;
         // when replacing the empty pattern, move on. See also kjs/regexp.cpp for how this should be done for regexps.
-        if (pattern.isEmpty()) {
+        if (pattern.isEmpty() && patterns.isEmpty()) {
             ++index;
         }
     }
@@ -352,6 +670,187 @@ void KReplacePrivate::doReplace()
 #endif
 }
 
+const KFindStrippedText *KReplacePrivate::matchedStrippedText()
+{
+    return (options & KFind::IgnoreDiacritics) ? &strippedText(text) : nullptr;
+}
+
+QList<KReplace::Replacement> KReplacePrivate::collectReplacements(QPromise<QList<KReplace::Replacement>> *promise)
+{
+    Q_Q(KReplace);
+
+    const KReplacementTemplate &repTemplate = replacementTemplate();
+    QRegularExpressionMatch *match = options & KFind::RegularExpression ? &m_match : nullptr;
+    QList<KReplace::Replacement> replacements;
+    while (index != INDEX_NOMATCH && index <= text.length()) {
+        if (promise) {
+            if (promise->isCanceled()) {
+                break;
+            }
+            promise->setProgressValue(index);
+        }
+        index = find(text, index, &matchedLength, match);
+        if (index == -1) {
+            break;
+        }
+        // Flexibility: the app can add more rules to validate a possible match
+        if (!q->validateMatch(text, index, matchedLength)) {
+            ++index;
+            continue;
+        }
+        replacements.append({index, matchedLength, repTemplate.expand(text, index, matchedLength, &m_match, matchedStrippedText())});
+        index += matchedLength;
+        // when the match is empty (e.g. replacing the empty pattern), move on
+        if (matchedLength == 0) {
+            ++index;
+        }
+    }
+    index = INDEX_NOMATCH;
+    return replacements;
+}
+
+bool KReplacePrivate::hasPendingReplacements() const
+{
+    return m_pendingValid && index == m_pendingIndex && text.constData() == m_pendingText.constData() && text.size() == m_pendingText.size()
+        && (options & ~KReplaceDialog::PromptOnReplace) == m_pendingOptions && pattern == m_pendingPattern && patterns == m_pendingPatterns;
+}
+
+QList<KReplace::Replacement> KReplace::pendingReplacements()
+{
+    Q_D(KReplace);
+
+    if (d->index == INDEX_NOMATCH) {
+        return {};
+    }
+    if (!d->hasPendingReplacements()) {
+        const int index = d->index;
+        const int matchedLength = d->matchedLength;
+        const QRegularExpressionMatch match = d->m_match;
+        d->m_pending = d->collectReplacements();
+        d->index = index;
+        d->matchedLength = matchedLength;
+        d->m_match = match;
+
+        d->m_pendingText = d->text;
+        d->m_pendingPattern = d->pattern;
+        d->m_pendingPatterns = d->patterns;
+        d->m_pendingIndex = d->index;
+        d->m_pendingOptions = d->options & ~KReplaceDialog::PromptOnReplace;
+        d->m_pendingValid = true;
+    }
+    return d->m_pending;
+}
+
+void KReplacePrivate::replaceAll()
+{
+    Q_Q(KReplace);
+
+    // Collect all the replacements first, against the unmodified text, so that
+    // the result can be assembled in a single pass instead of shifting the tail
+    // of the text for every replacement. A preview of them can be reused as is.
+    QList<KReplace::Replacement> replacements;
+    if (hasPendingReplacements()) {
+        replacements = std::move(m_pending);
+        index = INDEX_NOMATCH;
+    } else {
+        replacements = collectReplacements();
+    }
+    m_pending.clear();
+    m_pendingText.clear();
+    m_pendingValid = false;
+    if (replacements.isEmpty()) {
+        return;
+    }
+
+    if (q->isSignalConnected(QMetaMethod::fromSignal(&KReplace::textReplaced))) {
+        // textReplaced() gives the text as it is after each replacement, so
+        // do them one after another
+        int shift = 0;
+        for (const KReplace::Replacement &replacement : std::as_const(replacements)) {
+            text.replace(replacement.index + shift, replacement.matchedLength, replacement.text);
+            m_replacements++;
+            Q_EMIT q->textReplaced(text, replacement.index + shift, replacement.text.length(), replacement.matchedLength);
+            shift += replacement.text.length() - replacement.matchedLength;
+        }
+    } else {
+        qsizetype resultLength = text.length();
+        for (const KReplace::Replacement &replacement : std::as_const(replacements)) {
+            resultLength += replacement.text.length() - replacement.matchedLength;
+        }
+        QString result;
+        result.reserve(resultLength);
+        int sourceIndex = 0;
+        for (const KReplace::Replacement &replacement : std::as_const(replacements)) {
+            result.append(QStringView(text).mid(sourceIndex, replacement.index - sourceIndex));
+            result.append(replacement.text);
+            sourceIndex = replacement.index + replacement.matchedLength;
+        }
+        result.append(QStringView(text).mid(sourceIndex));
+        text = result;
+        m_replacements += replacements.size();
+    }
+
+    Q_EMIT q->replacementsDone(text, replacements);
+}
+
+// static
+qint64 KReplace::replaceAll(QIODevice *input, QIODevice *output, const QString &pattern, const QString &replacement, long options)
+{
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    auto write = [output, &encoder](QStringView text) {
+        const QByteArray encoded = encoder(text);
+        return output->write(encoded) == encoded.size();
+    };
+
+    // The template is parsed on the first match, which gives the regular expression
+    KReplacementTemplate repTemplate;
+    bool hasTemplate = false;
+    QString rep;
+    qint64 replacements = 0;
+
+    KFindStreamSearch search(pattern, options);
+    search.overlapping = false;
+    search.textHandler = write;
+    search.matchHandler = [&](qint64, const QString &text, int index, int length, const QRegularExpressionMatch *match) {
+        if (!hasTemplate) {
+            const QRegularExpression re = match ? match->regularExpression() : QRegularExpression();
+            repTemplate = KReplacementTemplate(replacement, options, match ? &re : nullptr);
+            hasTemplate = true;
+        }
+        rep.clear();
+        repTemplate.expandInto(rep, text, index, length, match);
+        ++replacements;
+        return write(rep);
+    };
+    if (!search.search(input)) {
+        return -1;
+    }
+    return replacements;
+}
+
+// static
+QFuture<QList<KReplace::Replacement>> KReplace::replaceAllAsync(const QString &text, const QString &pattern, const QString &replacement, int index, long options)
+{
+    auto promise = std::make_shared<QPromise<QList<Replacement>>>();
+    QFuture<QList<Replacement>> future = promise->future();
+    promise->start();
+    promise->setProgressRange(0, text.length());
+
+    QThreadPool::globalInstance()->start([promise, text, pattern, replacement, index, options]() {
+        // A private KReplace, living in this thread, gives the same results as
+        // a regular Replace All
+        KReplace replace(pattern, replacement, options & ~(KReplaceDialog::PromptOnReplace | KFind::FindBackwards | KFind::FindIncremental));
+        replace.setData(text, qMax(0, index));
+        const QList<Replacement> replacements = replace.d_func()->collectReplacements(promise.get());
+        if (!promise->isCanceled()) {
+            promise->setProgressValue(text.length());
+            promise->addResult(replacements);
+        }
+        promise->finish();
+    });
+    return future;
+}
+
 void KReplace::resetCounts()
 {
     Q_D(KReplace);
@@ -13,6 +13,8 @@
 
 #include "ktextwidgets_export.h"
 
+#include <QFuture>
+
 class KReplacePrivate;
 
 /**
@@ -107,8 +109,20 @@ public:
     ~KReplace() override;
 
     /**
-     * Return the number of replacements made (i.e. the number of times
-     * the textReplaced() signal was emitted).
+     * A replacement computed by pendingReplacements() or replaceAllAsync(),
+     * or done by a Replace All, see replacementsDone().
+     *
+     * @since 6.13
+     */
+    struct Replacement {
+        int index; ///< The index of the match in the original text
+        int matchedLength; ///< The length of the match
+        QString text; ///< The text replacing the match, with its placeholders expanded
+    };
+
+    /**
+     * Return the number of replacements made, including those of a Replace
+     * All done without emitting textReplaced(), see replacementsDone().
      *
      * Can be used in a dialog box to tell the user how many replacements were made.
      * The final dialog does so already, unless you used setDisplayFinalDialog(false).
@@ -126,9 +140,34 @@ public:
      * Walk the text fragment (e.g. kwrite line, kspread cell) looking for matches.
      * For each match, if prompt-on-replace is specified, emits the textFound() signal
      * and displays the prompt-for-replace dialog before doing the replace.
+     *
+     * When replacing forward without prompting, the matches are all found in
+     * the text as it was before any replacement, like QString::replace()
+     * does, rather than each in the text as the previous replacements left
+     * it. This only makes a difference for regular expressions which look at
+     * the text around their matches: since 6.13, replacing "^a" with nothing
+     * in "aaa" gives "aa", and replacing "(?<=b)a" with "b" in "baaa" gives
+     * "bbaa", while prompting, or replacing backwards, still gives "" and "bbbb".
      */
     Result replace();
 
+    /**
+     * Computes the replacements that replace() would do in the current text,
+     * from the current position to its end, when replacing forward without
+     * PromptOnReplace, but without changing the text or emitting any signal.
+     *
+     * This allows showing a preview, or the number of replacements, before
+     * replacing anything. As long as the text, the position in it, the pattern
+     * and the options don't change, the next call to replace() reuses these
+     * replacements instead of searching the text again.
+     *
+     * Candidate matches are checked with validateMatch(), like for replace().
+     *
+     * @return the replacements, ordered by index in the current text
+     * @since 6.13
+     */
+    QList<Replacement> pendingReplacements();
+
     /**
      * Return (or create) the dialog that shows the "find next?" prompt.
      * Usually you don't need to call this.
@@ -160,6 +199,55 @@ public:
      */
     static int replace(QString &text, const QString &pattern, const QString &replacement, int index, long options, int *replacedLength);
 
+    /**
+     * Computes, on a worker thread, the replacements of all the matches of
+     * @p pattern in @p text, from @p index to the end of the text, without
+     * changing anything.
+     *
+     * The replacements are ordered by index and don't overlap, so applying
+     * them from the last one to the first one gives the same text as replacing
+     * all the matches with replace() or a KReplace without PromptOnReplace.
+     * The KFind::FindBackwards and KReplaceDialog::PromptOnReplace options
+     * are ignored.
+     *
+     * The returned future reports its progress as the index reached in
+     * @p text, and stops searching when canceled, in which case it has no result.
+     *
+     * @param text The string to search
+     * @param pattern The pattern to search for
+     * @param replacement The replacement string, with the placeholders enabled by
+     *        KReplaceDialog::BackReference
+     * @param index The starting index into the string
+     * @param options The options to use
+     *
+     * @since 6.13
+     */
+    static QFuture<QList<Replacement>> replaceAllAsync(const QString &text, const QString &pattern, const QString &replacement, int index, long options);
+
+    /**
+     * Replaces all the matches of @p pattern in the UTF-8 encoded text read
+     * from @p input, from its current position to its end, writing the result
+     * to @p output, UTF-8 encoded too, as the search goes.
+     *
+     * Like findAll(QIODevice *, const QString &, long, bool *), this only keeps
+     * the part of the text which might still be matched in memory. The result
+     * is the same as with replace() on the whole text, going forward.
+     * The KFind::FindBackwards and KReplaceDialog::PromptOnReplace options
+     * are ignored.
+     *
+     * @param input The device to read, open for reading
+     * @param output The device to write to, open for writing
+     * @param pattern The pattern to search for
+     * @param replacement The replacement string, with the placeholders enabled by
+     *        KReplaceDialog::BackReference
+     * @param options The options to use
+     * @return the number of replacements, or -1 if the pattern is an invalid
+     *         regular expression, or if reading or writing failed
+     *
+     * @since 6.13
+     */
+    static qint64 replaceAll(QIODevice *input, QIODevice *output, const QString &pattern, const QString &replacement, long options);
+
     /**
      * Returns true if we should restart the search from scratch.
      * Can ask the user, or return false (if we already searched/replaced the
@@ -192,6 +280,11 @@ Q_SIGNALS:
      * might rely on it), and for performance reasons one should repaint after
      * replace() ONLY if prompt-on-replace was selected.
      *
+     * When replacing forward without prompting, all the replacements of the
+     * current text are found at once and replacementsDone() is emitted with
+     * them; building the text after each of them for this signal is only done
+     * when it is connected to.
+     *
      * @param text The text, in which the replacement has already been done
      * @param replacementIndex Starting index of the matched substring
      * @param replacedLength Length of the replacement string
@@ -201,7 +294,23 @@ Q_SIGNALS:
      */
     void textReplaced(const QString &text, int replacementIndex, int replacedLength, int matchedLength);
 
+    /**
+     * Emitted when replacing forward without prompting, once all the
+     * replacements of the current text were done in a single pass, after
+     * textReplaced() was emitted for each of them (if it is connected to).
+     *
+     * @param text The text, in which all the replacements have been done
+     * @param replacements The replacements done, in order, with the index of
+     *        their match in the text as it was before any of them
+     *
+     * @since 6.13
+     */
+    void replacementsDone(const QString &text, const QList<KReplace::Replacement> &replacements);
+
 private:
     Q_DECLARE_PRIVATE(KReplace)
 };
+
+Q_DECLARE_TYPEINFO(KReplace::Replacement, Q_RELOCATABLE_TYPE);
+
 #endif
@@ -52,6 +52,9 @@ public:
     enum Options {
         /// Should the user be prompted before the replace operation?
         PromptOnReplace = 256,
+        /// Expand placeholders in the replacement: \\0 for the matched text and, with
+        /// KFind::RegularExpression, \\N or \\g{name} and ${name} for captured text,
+        /// \\U, \\L and \\E to convert the case of what follows
         BackReference = 512,
     };
 
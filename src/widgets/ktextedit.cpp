@@ -17,8 +17,11 @@
 #include <QDebug>
 #include <QKeyEvent>
 #include <QMenu>
+#include <QMetaMethod>
+#include <QPromise>
 #include <QScrollBar>
 #include <QTextCursor>
+#include <QThreadPool>
 
 #include <KCursor>
 #include <KLocalizedString>
@@ -29,6 +32,17 @@
 #include <sonnet/configdialog.h>
 #include <sonnet/dialog.h>
 
+#include <algorithm>
+#include <memory>
+
+// Time spent searching at once by Find Next, in milliseconds; a longer search
+// goes on once the pending events were processed, so the editor stays responsive
+static const int FIND_TIME_SLICE = 50;
+// Interval at which the matches counted in the background are reported, and
+// time without edits after which the count starts again, in milliseconds
+static const int MATCH_COUNT_INTERVAL = 100;
+static const int MATCH_COUNT_DELAY = 300;
+
 class KTextDecorator : public Sonnet::SpellCheckDecorator
 {
 public:
@@ -84,7 +98,7 @@ void KTextEditPrivate::checkSpelling(bool force)
         // connect(spellDialog, SIGNAL(stop()), q, SIGNAL(spellCheckingFinished()));
     }
     originalDoc = QTextDocumentFragment(q->document());
-    spellDialog->setBuffer(q->toPlainText());
+    spellDialog->setBuffer(plainTextSnapshot());
     spellDialog->show();
 }
 
@@ -178,6 +192,84 @@ void KTextEditPrivate::menuActivated(QAction *action)
     }
 }
 
+QString KTextEditPrivate::plainTextSnapshot()
+{
+    Q_Q(KTextEdit);
+
+    QTextDocument *doc = q->document();
+    if (doc != snapshotDocument) {
+        QObject::disconnect(snapshotConnection);
+        snapshotDocument = doc;
+        snapshotRevision = -1;
+        // The revision alone isn't enough: it only changes with undo/redo
+        // enabled, and restarts when the document is cleared
+        snapshotConnection = QObject::connect(doc, &QTextDocument::contentsChanged, q, [this]() {
+            snapshotRevision = -1;
+            snapshot.clear();
+        });
+    }
+
+    if (snapshotRevision == -1 || snapshotRevision != doc->revision()) {
+        snapshot = doc->toPlainText();
+        snapshotRevision = doc->revision();
+    }
+    return snapshot;
+}
+
+// static
+bool KTextEditPrivate::needsWholeDocument(const QString &pattern, const QString &replacement, long options)
+{
+    // A regular expression can match a line break in too many ways (\s, [^a], ...)
+    if (options & KFind::RegularExpression) {
+        return true;
+    }
+    return pattern.contains(QLatin1Char('\n')) || replacement.contains(QLatin1Char('\n'));
+}
+
+// The @p text of a block, the way it is in QTextDocument::toPlainText()
+static QString searchText(QString text)
+{
+    text.replace(QChar::LineSeparator, QLatin1Char('\n'));
+    text.replace(QChar::Nbsp, QLatin1Char(' '));
+    return text;
+}
+
+static QString blockSearchText(const QTextBlock &block)
+{
+    return searchText(block.text());
+}
+
+bool KTextEditPrivate::setNextSearchData(KFind *finder, SearchData &searchData, int startPosition)
+{
+    Q_Q(KTextEdit);
+
+    if (!searchData.started) {
+        searchData.started = true;
+        if (searchData.wholeDocument) {
+            finder->setData(plainTextSnapshot(), startPosition);
+            return true;
+        }
+
+        searchData.block = q->document()->findBlock(startPosition);
+        if (!searchData.block.isValid()) {
+            searchData.block = q->document()->lastBlock();
+        }
+        const int blockStart = qBound(0, startPosition - searchData.block.position(), searchData.block.length() - 1);
+        finder->setData(blockSearchText(searchData.block), blockStart);
+        return true;
+    }
+
+    if (!searchData.block.isValid()) {
+        return false;
+    }
+    searchData.block = (finder->options() & KFind::FindBackwards) ? searchData.block.previous() : searchData.block.next();
+    if (!searchData.block.isValid()) {
+        return false;
+    }
+    finder->setData(blockSearchText(searchData.block));
+    return true;
+}
+
 void KTextEditPrivate::slotFindHighlight(const QString &text, int matchingIndex, int matchingLength)
 {
     Q_Q(KTextEdit);
@@ -189,6 +281,9 @@ void KTextEditPrivate::slotFindHighlight(const QString &text, int matchingIndex,
     tc.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, matchingLength);
     q->setTextCursor(tc);
     q->ensureCursorVisible();
+
+    currentMatchPosition = matchingIndex;
+    emitMatchCount();
 }
 
 void KTextEditPrivate::slotReplaceText(const QString &text, int replacementIndex, int replacedLength, int matchedLength)
@@ -196,16 +291,335 @@ void KTextEditPrivate::slotReplaceText(const QString &text, int replacementIndex
     Q_Q(KTextEdit);
 
     // qDebug() << "Replace: [" << text << "] ri:" << replacementIndex << " rl:" << replacedLength << " ml:" << matchedLength;
+    const int position = repData.position() + replacementIndex;
+    if (!(replace->options() & KReplaceDialog::PromptOnReplace)) {
+        // Replacing all backward (forward, they come to slotReplacementsDone()):
+        // editing the document only once all the replacements are known saves
+        // relayouting and highlighting it for each of them.
+        // Only the text after the match was replaced so far, unless the
+        // match overlaps the previous one
+        if (!pendingReplacements.isEmpty() && position + matchedLength > pendingReplacements.constLast().position) {
+            applyPendingReplacements();
+        }
+        pendingReplacements.append({position, matchedLength, text.mid(replacementIndex, replacedLength)});
+        return;
+    }
+
     QTextCursor tc = q->textCursor();
-    tc.setPosition(replacementIndex);
+    tc.setPosition(position);
     tc.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, matchedLength);
     tc.removeSelectedText();
     tc.insertText(text.mid(replacementIndex, replacedLength));
-    if (replace->options() & KReplaceDialog::PromptOnReplace) {
+    q->setTextCursor(tc);
+    q->ensureCursorVisible();
+    lastReplacedPosition = position;
+}
+
+void KTextEditPrivate::slotReplacementsDone(const QList<KReplace::Replacement> &replacements)
+{
+    // The matches are given at their position in the text as it was before
+    // any of them was replaced, so in the document until they are applied
+    const int position = repData.position();
+    for (const KReplace::Replacement &replacement : replacements) {
+        pendingReplacements.append({position + replacement.index, replacement.matchedLength, replacement.text});
+    }
+}
+
+void KTextEditPrivate::applyPendingReplacements()
+{
+    Q_Q(KTextEdit);
+
+    if (pendingReplacements.isEmpty()) {
+        return;
+    }
+
+    // Where the last replacement ends up, after those before it in the document
+    const PendingReplacement &last = pendingReplacements.constLast();
+    int lastPosition = last.position;
+    for (const PendingReplacement &replacement : std::as_const(pendingReplacements)) {
+        if (replacement.position < last.position) {
+            lastPosition += replacement.text.length() - replacement.matchedLength;
+        }
+    }
+
+    std::stable_sort(pendingReplacements.begin(), pendingReplacements.end(), [](const PendingReplacement &lhs, const PendingReplacement &rhs) {
+        return lhs.position > rhs.position;
+    });
+    QTextCursor tc(q->document());
+    tc.beginEditBlock();
+    for (const PendingReplacement &replacement : std::as_const(pendingReplacements)) {
+        tc.setPosition(replacement.position);
+        tc.setPosition(replacement.position + replacement.matchedLength, QTextCursor::KeepAnchor);
+        tc.removeSelectedText();
+        tc.insertText(replacement.text);
+    }
+    tc.endEditBlock();
+
+    pendingReplacements.clear();
+    lastReplacedPosition = lastPosition;
+}
+
+void KTextEditPrivate::startBackgroundReplace()
+{
+    Q_Q(KTextEdit);
+
+    stopBackgroundReplace();
+
+    QTextDocument *doc = q->document();
+    replaceAllDocument = doc;
+    replaceAllDocumentChanged = false;
+    replaceAllConnection = QObject::connect(doc, &QTextDocument::contentsChanged, q, [this]() {
+        replaceAllDocumentChanged = true;
+    });
+
+    auto *watcher = new QFutureWatcher<QList<KReplace::Replacement>>(q);
+    QObject::connect(watcher, &QFutureWatcherBase::progressValueChanged, q, [q, watcher](int value) {
+        Q_EMIT q->replaceAllProgress(value, watcher->progressMaximum());
+    });
+    QObject::connect(watcher, &QFutureWatcherBase::finished, q, [this]() {
+        finishBackgroundReplace();
+    });
+    replaceAllWatcher = watcher;
+    watcher->setFuture(KReplace::replaceAllAsync(plainTextSnapshot(), replace->pattern(), repDlg->replacement(), repIndex, replace->options()));
+}
+
+void KTextEditPrivate::continueFind()
+{
+    Q_Q(KTextEdit);
+
+    if (!findTimer) {
+        findTimer = new QTimer(q);
+        findTimer->setSingleShot(true);
+        QObject::connect(findTimer, &QTimer::timeout, q, [this, q]() {
+            if (!find) {
+                return;
+            }
+            // Find Previous only reverses the direction while it searches
+            const long options = find->options();
+            if (options != findTimerOptions) {
+                find->setOptions(findTimerOptions);
+            }
+            q->slotFindNext();
+            if (find && options != findTimerOptions) {
+                find->setOptions(options);
+            }
+        });
+    }
+    findTimerOptions = find->options();
+    findTimer->start(0);
+}
+
+void KTextEditPrivate::finishBackgroundReplace()
+{
+    Q_Q(KTextEdit);
+
+    QObject::disconnect(replaceAllConnection);
+    auto *watcher = replaceAllWatcher;
+    replaceAllWatcher = nullptr;
+    watcher->deleteLater();
+
+    if (replace) {
+        replace->disconnect(q);
+        replace->deleteLater();
+        replace = nullptr;
+    }
+
+    if (watcher->isCanceled()) {
+        Q_EMIT q->replaceAllCanceled();
+        return;
+    }
+    if (replaceAllDocumentChanged || replaceAllDocument != q->document()) {
+        KMessageBox::information(q, i18n("The text was modified while searching for the text to replace, so nothing was replaced."));
+        Q_EMIT q->replaceAllCanceled();
+        return;
+    }
+
+    const QList<KReplace::Replacement> replacements = watcher->result();
+    for (const KReplace::Replacement &replacement : replacements) {
+        pendingReplacements.append({replacement.index, replacement.matchedLength, replacement.text});
+    }
+    lastReplacedPosition = -1;
+    q->viewport()->setUpdatesEnabled(false);
+    applyPendingReplacements();
+    if (lastReplacedPosition >= 0) {
+        QTextCursor tc = q->textCursor();
+        tc.setPosition(lastReplacedPosition);
         q->setTextCursor(tc);
-        q->ensureCursorVisible();
     }
-    lastReplacedPosition = replacementIndex;
+    q->viewport()->setUpdatesEnabled(true);
+    q->viewport()->update();
+    q->ensureCursorVisible();
+
+    if (replacements.isEmpty()) {
+        KMessageBox::information(q, i18n("No text was replaced."));
+    } else {
+        KMessageBox::information(q, i18np("1 replacement done.", "%1 replacements done.", replacements.size()));
+    }
+    Q_EMIT q->replaceAllFinished(replacements.size());
+}
+
+void KTextEditPrivate::stopBackgroundReplace()
+{
+    QObject::disconnect(replaceAllConnection);
+    if (replaceAllWatcher) {
+        replaceAllWatcher->disconnect();
+        replaceAllWatcher->cancel();
+        replaceAllWatcher->deleteLater();
+        replaceAllWatcher = nullptr;
+    }
+}
+
+// A text searched for counting the matches, at its position in the document
+struct CountedText {
+    int position;
+    QString text;
+};
+
+// Counts the matches of @p pattern in @p texts on a worker thread, the way
+// KTextEdit::slotFindNext() finds them: the texts are either those of the
+// blocks, or the whole document. The positions of the matches found are
+// added as a result every MATCH_COUNT_INTERVAL milliseconds, and once all
+// the texts were searched.
+static QFuture<QList<int>> countMatchesAsync(const QList<CountedText> &texts, const QString &pattern, long options)
+{
+    auto promise = std::make_shared<QPromise<QList<int>>>();
+    QFuture<QList<int>> future = promise->future();
+    promise->start();
+
+    QThreadPool::globalInstance()->start([promise, texts, pattern, options]() {
+        // A private KFind, living in this thread, steps through the same
+        // matches as Find Next
+        KFind find(pattern, options & ~(KFind::FindBackwards | KFind::FromCursor | KFind::SelectedText | KFind::FindIncremental), nullptr);
+        find.closeFindNextDialog();
+
+        QList<int> positions;
+        int position = 0; // of the text being searched
+        QObject::connect(&find, &KFind::textFound, [&positions, &position](const QString &, int matchingIndex) {
+            positions.append(position + matchingIndex);
+        });
+
+        QDeadlineTimer interval(MATCH_COUNT_INTERVAL);
+        for (const CountedText &text : texts) {
+            // converting the texts like QTextDocument::toPlainText() is
+            // done here rather than on the GUI thread
+            position = text.position;
+            find.setData(searchText(text.text));
+            KFind::Result res;
+            do {
+                res = find.find(interval);
+                if (interval.hasExpired()) {
+                    if (promise->isCanceled()) {
+                        promise->finish();
+                        return;
+                    }
+                    if (!positions.isEmpty()) {
+                        promise->addResult(std::exchange(positions, {}));
+                    }
+                    interval.setRemainingTime(MATCH_COUNT_INTERVAL);
+                }
+            } while (res != KFind::NoMatch);
+        }
+
+        if (!promise->isCanceled() && !positions.isEmpty()) {
+            promise->addResult(positions);
+        }
+        promise->finish();
+    });
+    return future;
+}
+
+void KTextEditPrivate::startMatchCount()
+{
+    Q_Q(KTextEdit);
+
+    stopMatchCount();
+    matchOffsets.clear();
+    matchCountComplete = false;
+
+    QObject::disconnect(matchCountConnection);
+    matchCountConnection = QObject::connect(q->document(), &QTextDocument::contentsChanged, q, [this, q]() {
+        // The matches counted so far are wrong now; counting them again
+        // after each key press would be wasted, so wait for a pause
+        stopMatchCount();
+        matchOffsets.clear();
+        matchCountComplete = false;
+        currentMatchPosition = -1;
+        emitMatchCount();
+        if (!matchCountTimer) {
+            matchCountTimer = new QTimer(q);
+            matchCountTimer->setSingleShot(true);
+            matchCountTimer->setInterval(MATCH_COUNT_DELAY);
+            QObject::connect(matchCountTimer, &QTimer::timeout, q, [this]() {
+                if (find) {
+                    startMatchCount();
+                }
+            });
+        }
+        matchCountTimer->start();
+    });
+
+    auto *watcher = new QFutureWatcher<QList<int>>(q);
+    QObject::connect(watcher, &QFutureWatcherBase::resultsReadyAt, q, [this, watcher](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            matchOffsets.append(watcher->resultAt(i));
+        }
+        emitMatchCount();
+    });
+    QObject::connect(watcher, &QFutureWatcherBase::finished, q, [this, watcher]() {
+        matchCountWatcher = nullptr;
+        watcher->deleteLater();
+        matchCountComplete = !watcher->isCanceled();
+        emitMatchCount();
+    });
+    matchCountWatcher = watcher;
+
+    // The texts are taken at their position in the document, which isn't
+    // where the previous block ends around tables and frames. Those of the
+    // blocks share their data with the document; the whole document is the
+    // snapshot the search goes through as well.
+    QList<CountedText> texts;
+    if (findData.wholeDocument) {
+        texts.append({0, plainTextSnapshot()});
+    } else {
+        texts.reserve(q->document()->blockCount());
+        for (QTextBlock block = q->document()->begin(); block.isValid(); block = block.next()) {
+            texts.append({block.position(), block.text()});
+        }
+    }
+    watcher->setFuture(countMatchesAsync(texts, find->pattern(), find->options()));
+}
+
+void KTextEditPrivate::stopMatchCount()
+{
+    if (matchCountTimer) {
+        matchCountTimer->stop();
+    }
+    if (matchCountWatcher) {
+        matchCountWatcher->disconnect();
+        matchCountWatcher->cancel();
+        matchCountWatcher->deleteLater();
+        matchCountWatcher = nullptr;
+    }
+}
+
+void KTextEditPrivate::endMatchCount()
+{
+    QObject::disconnect(matchCountConnection);
+    stopMatchCount();
+}
+
+void KTextEditPrivate::emitMatchCount()
+{
+    Q_Q(KTextEdit);
+
+    // The positions are sorted, so finding the current match among
+    // thousands of them doesn't slow down stepping through them
+    int current = 0;
+    const auto it = std::lower_bound(matchOffsets.cbegin(), matchOffsets.cend(), currentMatchPosition);
+    if (it != matchOffsets.cend() && *it == currentMatchPosition) {
+        current = it - matchOffsets.cbegin() + 1;
+    }
+    Q_EMIT q->findMatchCountChanged(current, matchOffsets.size(), matchCountComplete);
 }
 
 void KTextEditPrivate::init()
@@ -579,7 +993,7 @@ void KTextEdit::slotSpeakText()
     if (textCursor().hasSelection()) {
         text = textCursor().selectedText();
     } else {
-        text = toPlainText();
+        text = d->plainTextSnapshot();
     }
     if (!d->textToSpeech) {
         d->textToSpeech = new QTextToSpeech(this);
@@ -783,6 +1197,7 @@ void KTextEdit::slotDoReplace()
         return;
     }
 
+    d->stopBackgroundReplace();
     if (d->repDlg->pattern().isEmpty()) {
         delete d->replace;
         d->replace = nullptr;
@@ -796,15 +1211,17 @@ void KTextEdit::slotDoReplace()
     if (d->replace->options() & KFind::FromCursor || d->replace->options() & KFind::FindBackwards) {
         d->repIndex = textCursor().anchor();
     }
+    d->repData = KTextEditPrivate::SearchData();
+    d->repData.wholeDocument = KTextEditPrivate::needsWholeDocument(d->repDlg->pattern(), d->repDlg->replacement(), d->replace->options());
 
     // Connect textFound signal to code which handles highlighting of found text.
     connect(d->replace, &KFind::textFound, this, [d](const QString &text, int matchingIndex, int matchedLength) {
-        d->slotFindHighlight(text, matchingIndex, matchedLength);
+        d->slotFindHighlight(text, d->repData.position() + matchingIndex, matchedLength);
     });
     connect(d->replace, &KFind::findNext, this, &KTextEdit::slotReplaceNext);
 
-    connect(d->replace, &KReplace::textReplaced, this, [d](const QString &text, int replacementIndex, int replacedLength, int matchedLength) {
-        d->slotReplaceText(text, replacementIndex, replacedLength, matchedLength);
+    connect(d->replace, &KReplace::replacementsDone, this, [d](const QString &, const QList<KReplace::Replacement> &replacements) {
+        d->slotReplacementsDone(replacements);
     });
 
     d->repDlg->close();
@@ -819,17 +1236,40 @@ void KTextEdit::slotReplaceNext()
         return;
     }
 
+    // Only a Replace All started from the dialog, going forward, can be
+    // done in the background
+    if (d->replaceAllInBackground && !d->repData.started
+        && !(d->replace->options() & (KReplaceDialog::PromptOnReplace | KFind::FindBackwards))) {
+        d->startBackgroundReplace();
+        return;
+    }
+
+    // Replacing forward without prompting gives the replacements of each
+    // block all at once to slotReplacementsDone(); not listening to
+    // textReplaced() then spares KReplace building the text after each of them
+    QObject::disconnect(d->replaceTextConnection);
+    if (d->replace->options() & (KReplaceDialog::PromptOnReplace | KFind::FindBackwards)) {
+        d->replaceTextConnection =
+            connect(d->replace, &KReplace::textReplaced, this, [d](const QString &text, int replacementIndex, int replacedLength, int matchedLength) {
+                d->slotReplaceText(text, replacementIndex, replacedLength, matchedLength);
+            });
+    }
+
     d->lastReplacedPosition = -1;
     if (!(d->replace->options() & KReplaceDialog::PromptOnReplace)) {
         textCursor().beginEditBlock(); // #48541
         viewport()->setUpdatesEnabled(false);
     }
 
-    if (d->replace->needData()) {
-        d->replace->setData(toPlainText(), d->repIndex);
-    }
-    KFind::Result res = d->replace->replace();
+    KFind::Result res = KFind::NoMatch;
+    do {
+        if (d->replace->needData() && !d->setNextSearchData(d->replace, d->repData, d->repIndex)) {
+            break;
+        }
+        res = d->replace->replace();
+    } while (res == KFind::NoMatch);
     if (!(d->replace->options() & KReplaceDialog::PromptOnReplace)) {
+        d->applyPendingReplacements();
         textCursor().endEditBlock(); // #48541
         if (d->lastReplacedPosition >= 0) {
             QTextCursor tc = textCursor();
@@ -865,6 +1305,7 @@ void KTextEdit::slotDoFind()
     if (d->findDlg->pattern().isEmpty()) {
         delete d->find;
         d->find = nullptr;
+        d->endMatchCount();
         return;
     }
     delete d->find;
@@ -873,12 +1314,22 @@ void KTextEdit::slotDoFind()
     if (d->find->options() & KFind::FromCursor || d->find->options() & KFind::FindBackwards) {
         d->findIndex = textCursor().anchor();
     }
+    d->findData = KTextEditPrivate::SearchData();
+    d->findData.wholeDocument = KTextEditPrivate::needsWholeDocument(d->findDlg->pattern(), QString(), d->find->options());
 
     // Connect textFound() signal to code which handles highlighting of found text
     connect(d->find, &KFind::textFound, this, [d](const QString &text, int matchingIndex, int matchedLength) {
-        d->slotFindHighlight(text, matchingIndex, matchedLength);
+        d->slotFindHighlight(text, d->findData.position() + matchingIndex, matchedLength);
     });
     connect(d->find, &KFind::findNext, this, &KTextEdit::slotFindNext);
+    d->currentMatchPosition = -1;
+    // counting the matches means searching the whole document once more,
+    // which is wasted when nobody shows the count
+    if (isSignalConnected(QMetaMethod::fromSignal(&KTextEdit::findMatchCountChanged))) {
+        d->startMatchCount();
+    } else {
+        d->endMatchCount();
+    }
 
     d->findDlg->close();
     d->find->closeFindNextDialog();
@@ -889,6 +1340,9 @@ void KTextEdit::slotFindNext()
 {
     Q_D(KTextEdit);
 
+    if (d->findTimer) {
+        d->findTimer->stop();
+    }
     if (!d->find) {
         return;
     }
@@ -896,19 +1350,33 @@ void KTextEdit::slotFindNext()
         d->find->disconnect(this);
         d->find->deleteLater(); // we are in a slot connected to m_find, don't delete right away
         d->find = nullptr;
+        d->endMatchCount();
         return;
     }
 
-    if (d->find->needData()) {
-        d->find->setData(toPlainText(), d->findIndex);
-    }
-    KFind::Result res = d->find->find();
+    const QDeadlineTimer deadline(FIND_TIME_SLICE);
+    KFind::Result res = KFind::NoMatch;
+    do {
+        if (d->find->needData()) {
+            if (deadline.hasExpired()) {
+                res = KFind::Interrupted;
+                break;
+            }
+            if (!d->setNextSearchData(d->find, d->findData, d->findIndex)) {
+                break;
+            }
+        }
+        res = d->find->find(deadline);
+    } while (res == KFind::NoMatch);
 
-    if (res == KFind::NoMatch) {
+    if (res == KFind::Interrupted) {
+        d->continueFind();
+    } else if (res == KFind::NoMatch) {
         d->find->displayFinalDialog();
         d->find->disconnect(this);
         d->find->deleteLater(); // we are in a slot connected to m_find, don't delete right away
         d->find = nullptr;
+        d->endMatchCount();
         // or           if ( m_find->shouldRestart() ) { reinit (w/o FromCursor) and call slotFindNext(); }
     } else {
         // m_find->closeFindNextDialog();
@@ -964,6 +1432,29 @@ void KTextEdit::slotReplace()
     d->repDlg->show();
 }
 
+void KTextEdit::setReplaceAllInBackground(bool background)
+{
+    Q_D(KTextEdit);
+
+    d->replaceAllInBackground = background;
+}
+
+bool KTextEdit::replaceAllInBackground() const
+{
+    Q_D(const KTextEdit);
+
+    return d->replaceAllInBackground;
+}
+
+void KTextEdit::cancelReplaceAll()
+{
+    Q_D(KTextEdit);
+
+    if (d->replaceAllWatcher) {
+        d->replaceAllWatcher->cancel();
+    }
+}
+
 void KTextEdit::enableFindReplace(bool enabled)
 {
     Q_D(KTextEdit);
@@ -195,6 +195,29 @@ public:
      */
     void forceSpellChecking();
 
+    /**
+     * Sets whether replacing all the matches, i.e.\ without PromptOnReplace,
+     * searches the document on a worker thread, so that the window stays
+     * responsive with large documents.
+     *
+     * Progress is reported by replaceAllProgress(), and the search can be
+     * stopped with cancelReplaceAll(). The document is only changed once all
+     * the replacements are known, in a single step, and not at all if it was
+     * modified in the meantime.
+     *
+     * Replacing backwards is always done on the GUI thread. Disabled by default.
+     *
+     * @since 6.13
+     */
+    void setReplaceAllInBackground(bool background);
+
+    /**
+     * @return whether replacing all the matches is done on a worker thread
+     * @see setReplaceAllInBackground()
+     * @since 6.13
+     */
+    bool replaceAllInBackground() const;
+
 Q_SIGNALS:
     /**
      * emit signal when we activate or not autospellchecking
@@ -250,6 +273,53 @@ Q_SIGNALS:
      */
     void spellCheckingCanceled();
 
+    /**
+     * Emitted while replacing all the matches in the background, with the
+     * number of characters of the document searched so far, out of @p total.
+     *
+     * @see setReplaceAllInBackground()
+     * @since 6.13
+     */
+    void replaceAllProgress(int searched, int total);
+
+    /**
+     * Emitted when the replacements found in the background were applied
+     * to the document.
+     *
+     * @param replacements the number of replacements done
+     * @see setReplaceAllInBackground()
+     * @since 6.13
+     */
+    void replaceAllFinished(int replacements);
+
+    /**
+     * Emitted when replacing all the matches in the background was canceled
+     * with cancelReplaceAll(), or gave up because the document was modified
+     * in the meantime. Nothing was replaced in that case.
+     *
+     * @see setReplaceAllInBackground()
+     * @since 6.13
+     */
+    void replaceAllCanceled();
+
+    /**
+     * Emitted while the matches of a Find are counted in the background,
+     * when the search moves to another match, and when editing the document
+     * restarts the count.
+     *
+     * The matches are only counted when this signal is connected at the
+     * time the Find starts.
+     *
+     * @param current the number of the current match, starting at 1, or 0
+     *        while it isn't known (before the first match, or when the count
+     *        didn't reach it yet)
+     * @param total the number of matches counted so far
+     * @param complete whether the whole document was counted, i.e. whether
+     *        @p total is final
+     * @since 6.13
+     */
+    void findMatchCountChanged(int current, int total, bool complete);
+
 public Q_SLOTS:
 
     /**
@@ -301,6 +371,15 @@ public Q_SLOTS:
      */
     void clearDecorator();
 
+    /**
+     * Stops replacing all the matches in the background, if that is under way.
+     * replaceAllCanceled() is emitted once the search is stopped.
+     *
+     * @see setReplaceAllInBackground()
+     * @since 6.13
+     */
+    void cancelReplaceAll();
+
 protected Q_SLOTS:
     /**
      * @since 4.1
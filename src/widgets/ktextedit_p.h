@@ -18,8 +18,13 @@
 #include <Sonnet/SpellCheckDecorator>
 #include <Sonnet/Speller>
 
+#include <QFutureWatcher>
+#include <QList>
+#include <QPointer>
 #include <QSettings>
+#include <QTextBlock>
 #include <QTextDocumentFragment>
+#include <QTimer>
 #ifdef HAVE_SPEECH
 #include <QTextToSpeech>
 #endif
@@ -49,6 +54,8 @@ public:
         delete find;
         delete replace;
         delete repDlg;
+        stopBackgroundReplace();
+        endMatchCount();
         delete speller;
 #ifdef HAVE_SPEECH
         delete textToSpeech;
@@ -73,8 +80,103 @@ public:
     void spellCheckerFinished();
     void toggleAutoSpellCheck();
 
+    /**
+     * The part of the document given to a KFind or KReplace: one block at a
+     * time, so that the document doesn't need to be copied, or all of it when
+     * a match might span several blocks.
+     */
+    struct SearchData {
+        QTextBlock block; // invalid when searching the whole document
+        bool wholeDocument = false;
+        bool started = false;
+
+        // the document position of the text being searched
+        int position() const
+        {
+            return block.isValid() ? block.position() : 0;
+        }
+    };
+
+    /**
+     * Whether a match of @p pattern, and its @p replacement, can span several blocks.
+     */
+    static bool needsWholeDocument(const QString &pattern, const QString &replacement, long options);
+    /**
+     * Passes the next text to search to @p finder: the block containing
+     * @p startPosition the first time, then the following (or, with
+     * KFind::FindBackwards, the preceding) blocks.
+     * Returns false once the whole document was searched.
+     */
+    bool setNextSearchData(KFind *finder, SearchData &searchData, int startPosition);
+
+    /**
+     * Returns the plain text of the document, like QTextEdit::toPlainText(),
+     * but only extracts it again when the document changed since the last
+     * call; the returned string shares its data with the cached one.
+     */
+    QString plainTextSnapshot();
+
     void slotFindHighlight(const QString &text, int matchingIndex, int matchingLength);
+    /**
+     * Calls KTextEdit::slotFindNext() again once the pending events were
+     * processed, for going on with an interrupted search.
+     */
+    void continueFind();
     void slotReplaceText(const QString &text, int replacementIndex, int /*replacedLength*/, int matchedLength);
+    /**
+     * Collects the replacements of a block done at once by a forward Replace All.
+     */
+    void slotReplacementsDone(const QList<KReplace::Replacement> &replacements);
+
+    /**
+     * A replacement collected while replacing without prompting, so that all
+     * of them can be applied at once by applyPendingReplacements().
+     */
+    struct PendingReplacement {
+        int position; // in the document as it was when the replacements were collected
+        int matchedLength;
+        QString text;
+    };
+    /**
+     * Applies the collected replacements in a single edit block, starting
+     * from the end of the document so that none of them moves the others.
+     */
+    void applyPendingReplacements();
+
+    /**
+     * Starts computing the replacements of a Replace All on a worker thread,
+     * over a snapshot of the document.
+     */
+    void startBackgroundReplace();
+    /**
+     * Applies the replacements computed by startBackgroundReplace(), unless
+     * that was canceled or the document changed since.
+     */
+    void finishBackgroundReplace();
+    /**
+     * Forgets about the replacements being computed in the background, if any.
+     */
+    void stopBackgroundReplace();
+
+    /**
+     * Starts counting the matches of the current Find on a worker thread,
+     * over the texts of the blocks of the document, restarting any count in
+     * progress.
+     */
+    void startMatchCount();
+    /**
+     * Forgets about the matches being counted in the background, if any.
+     */
+    void stopMatchCount();
+    /**
+     * Stops counting the matches, also when the document changes, once the
+     * Find they were counted for is over.
+     */
+    void endMatchCount();
+    /**
+     * Emits KTextEdit::findMatchCountChanged() for the matches counted so far.
+     */
+    void emitMatchCount();
 
     /**
      * Similar to QTextEdit::clear(), only that it is possible to undo this
@@ -114,7 +216,38 @@ public:
 
     int findIndex = 0;
     int repIndex = 0;
+    // goes on with an interrupted search, in the direction it had
+    QTimer *findTimer = nullptr;
+    long findTimerOptions = 0;
+    SearchData findData;
+    SearchData repData;
+
+    // cache for plainTextSnapshot(), keyed on the document and its revision
+    QString snapshot;
+    QPointer<QTextDocument> snapshotDocument;
+    int snapshotRevision = -1;
+    QMetaObject::Connection snapshotConnection;
     int lastReplacedPosition = -1;
+    QList<PendingReplacement> pendingReplacements;
+    // to KReplace::textReplaced(), only needed when prompting or replacing backward
+    QMetaObject::Connection replaceTextConnection;
+
+    bool replaceAllInBackground = false;
+    QFutureWatcher<QList<KReplace::Replacement>> *replaceAllWatcher = nullptr;
+    // the document being replaced in the background, and whether it changed since
+    QPointer<QTextDocument> replaceAllDocument;
+    bool replaceAllDocumentChanged = false;
+    QMetaObject::Connection replaceAllConnection;
+
+    QFutureWatcher<QList<int>> *matchCountWatcher = nullptr;
+    // the document positions of the matches counted so far, in order
+    QList<int> matchOffsets;
+    bool matchCountComplete = false;
+    // the document position of the current match, or -1
+    int currentMatchPosition = -1;
+    // restarts counting once the document wasn't edited for a while
+    QTimer *matchCountTimer = nullptr;
+    QMetaObject::Connection matchCountConnection;
 };
 
 #endif